@@ -0,0 +1,381 @@
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* HID traffic capture file format (all fields little-endian):
+   - CaptureHeader
+   - CaptureRecord entries, each followed by its report data and padded to 8 bytes
+   - Device table: per device a uint16_t name length followed by the UTF-8 name
+   - Sparse CaptureIndexEntry table (one entry per CAPTURE_INDEX_INTERVAL records) for fast seeking
+   The header is rewritten on close, so an unfinished capture has zero records. */
+
+static constexpr char     CAPTURE_MAGIC[8] = {'H', 'I', 'D', 'C', 'A', 'P', '0', '1'};
+static constexpr uint32_t CAPTURE_VERSION = 1;
+static constexpr uint32_t CAPTURE_INDEX_INTERVAL = 1024;
+
+struct CaptureHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t deviceCount;
+    uint64_t recordCount;
+    uint64_t deviceOffset; // start of device table (end of records)
+    uint64_t indexOffset;  // start of index table
+    uint64_t indexCount;
+    uint64_t startTime;    // wall-clock time at start (ns since 1970)
+};
+static_assert(sizeof(CaptureHeader) == 56, "CaptureHeader size mismatch");
+
+/** Report direction. */
+enum CaptureFlags : uint8_t {
+    CAPTURE_SENT = 0x01,     // sent to device (otherwise received)
+    CAPTURE_FAILED = 0x02,   // request failed
+};
+
+struct CaptureRecord {
+    uint64_t time;   // ns since start of capture
+    uint16_t device; // index into device table
+    uint8_t  kind;   // 0=input, 1=output, 2=feature (HIDP_REPORT_TYPE)
+    uint8_t  flags;  // CaptureFlags
+    uint16_t length; // report length in bytes (including report ID)
+    uint16_t reserved;
+};
+static_assert(sizeof(CaptureRecord) == 16, "CaptureRecord size mismatch");
+
+struct CaptureIndexEntry {
+    uint64_t time;
+    uint64_t offset; // file offset of record
+};
+
+
+/** Capture file writer. Write is thread-safe. */
+class CaptureWriter {
+public:
+    ~CaptureWriter() {
+        Close();
+    }
+
+    bool Open(const char* path) {
+#ifdef _WIN32
+        if (fopen_s(&m_file, path, "wb"))
+            m_file = nullptr;
+#else
+        m_file = fopen(path, "wb");
+#endif
+        if (!m_file)
+            return false;
+
+        setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+        m_start = Now();
+        m_header = {};
+        memcpy(m_header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        m_header.version = CAPTURE_VERSION;
+        m_header.startTime = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        fwrite(&m_header, sizeof(m_header), 1, m_file); // placeholder
+        m_offset = sizeof(m_header);
+        return true;
+    }
+
+    /** Register a device by name. Returns its index. */
+    uint16_t AddDevice(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_devices.size(); i++) {
+            if (m_devices[i] == name)
+                return (uint16_t)i;
+        }
+        m_devices.push_back(name);
+        return (uint16_t)(m_devices.size() - 1);
+    }
+
+#ifdef _WIN32
+    uint16_t AddDevice(const std::wstring& name) {
+        return AddDevice(ToUtf8(name));
+    }
+
+    static std::string ToUtf8(const std::wstring& str) {
+        int length = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.size(), NULL, 0, NULL, NULL);
+        std::string utf8(length, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.size(), utf8.data(), length, NULL, NULL);
+        return utf8;
+    }
+#endif
+
+    /** Append a report. "time" is a std::chrono::steady_clock timestamp in ns. */
+    void Write(uint64_t time, uint16_t device, uint8_t kind, uint8_t flags, const void* data, uint16_t length) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file)
+            return;
+
+        CaptureRecord record = {};
+        record.time = (time > m_start) ? time - m_start : 0;
+        record.device = device;
+        record.kind = kind;
+        record.flags = flags;
+        record.length = length;
+
+        if (m_header.recordCount % CAPTURE_INDEX_INTERVAL == 0)
+            m_index.push_back({record.time, m_offset});
+
+        static const uint8_t padding[8] = {};
+        size_t pad = (8 - length % 8) % 8;
+        fwrite(&record, sizeof(record), 1, m_file);
+        fwrite(data, 1, length, m_file);
+        fwrite(padding, 1, pad, m_file);
+        m_offset += sizeof(record) + length + pad;
+        m_header.recordCount++;
+    }
+
+    /** Append a report with the current time. */
+    void Write(uint16_t device, uint8_t kind, uint8_t flags, const void* data, uint16_t length) {
+        Write(Now(), device, kind, flags, data, length);
+    }
+
+    /** Write device table, index and final header. */
+    bool Close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file)
+            return false;
+
+        m_header.deviceOffset = m_offset;
+        m_header.deviceCount = (uint32_t)m_devices.size();
+        for (const std::string& name : m_devices) {
+            uint16_t length = (uint16_t)name.size();
+            fwrite(&length, sizeof(length), 1, m_file);
+            fwrite(name.data(), 1, length, m_file);
+            m_offset += sizeof(length) + length;
+        }
+
+        m_header.indexOffset = m_offset;
+        m_header.indexCount = m_index.size();
+        fwrite(m_index.data(), sizeof(CaptureIndexEntry), m_index.size(), m_file);
+
+        fseek(m_file, 0, SEEK_SET);
+        fwrite(&m_header, sizeof(m_header), 1, m_file);
+        bool ok = !ferror(m_file);
+        fclose(m_file);
+        m_file = nullptr;
+        return ok;
+    }
+
+    static uint64_t Now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::mutex                     m_mutex;
+    FILE*                          m_file = nullptr;
+    CaptureHeader                  m_header = {};
+    uint64_t                       m_start = 0;  // steady_clock time at start (ns)
+    uint64_t                       m_offset = 0; // current file offset
+    std::vector<std::string>       m_devices;
+    std::vector<CaptureIndexEntry> m_index;
+};
+
+
+/** Memory-mapped capture file reader. */
+class CaptureReader {
+public:
+    ~CaptureReader() {
+        Close();
+    }
+
+    bool Open(const char* path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size = {};
+        GetFileSizeEx(file, &size);
+        HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (!mapping)
+            return false;
+        m_data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); // view keeps mapping alive
+        m_size = (size_t)size.QuadPart;
+#else
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st = {};
+        fstat(fd, &st);
+        m_size = (size_t)st.st_size;
+        void* data = (m_size > 0) ? mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd); // mapping stays valid
+        m_data = (data != MAP_FAILED) ? (const uint8_t*)data : nullptr;
+        if (m_data)
+            madvise(data, m_size, MADV_SEQUENTIAL);
+#endif
+        if (!m_data)
+            return false;
+
+        if (!Validate()) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (!m_data)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap((void*)m_data, m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const CaptureHeader& Header() const {
+        return *(const CaptureHeader*)m_data;
+    }
+
+    const std::vector<std::string>& Devices() const {
+        return m_devices;
+    }
+
+    /** First record, or nullptr if the capture is empty. */
+    const CaptureRecord* First() const {
+        return Check(sizeof(CaptureHeader));
+    }
+
+    /** Record following "record", or nullptr at the end. */
+    const CaptureRecord* Next(const CaptureRecord* record) const {
+        size_t offset = (const uint8_t*)record - m_data;
+        return Check(offset + sizeof(CaptureRecord) + (record->length + 7) / 8 * 8);
+    }
+
+    /** First record at or after "time" (ns since start), or nullptr if none. */
+    const CaptureRecord* Seek(uint64_t time) const {
+        const CaptureIndexEntry* index = (const CaptureIndexEntry*)(m_data + Header().indexOffset);
+        size_t lo = 0, hi = Header().indexCount; // find last index entry before time
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (index[mid].time < time)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        const CaptureRecord* record = Header().indexCount ? Check(index[lo].offset) : First();
+        while (record && (record->time < time))
+            record = Next(record);
+        return record;
+    }
+
+    static const uint8_t* Data(const CaptureRecord* record) {
+        return (const uint8_t*)(record + 1);
+    }
+
+private:
+    bool Validate() {
+        if (m_size < sizeof(CaptureHeader))
+            return false;
+
+        const CaptureHeader& header = Header();
+        if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) || (header.version != CAPTURE_VERSION))
+            return false;
+        if ((header.deviceOffset > m_size) || (header.indexOffset > m_size) || (header.indexCount > (m_size - header.indexOffset) / sizeof(CaptureIndexEntry)))
+            return false;
+
+        m_devices.clear();
+        size_t offset = (size_t)header.deviceOffset;
+        for (uint32_t i = 0; i < header.deviceCount; i++) {
+            uint16_t length = 0;
+            if (offset + sizeof(length) > header.indexOffset)
+                return false;
+            memcpy(&length, m_data + offset, sizeof(length));
+            offset += sizeof(length);
+            if (offset + length > header.indexOffset)
+                return false;
+            m_devices.emplace_back((const char*)m_data + offset, length);
+            offset += length;
+        }
+        return true;
+    }
+
+    /** Returns record at offset if it lies within the record area. */
+    const CaptureRecord* Check(size_t offset) const {
+        size_t end = (size_t)Header().deviceOffset;
+        if (offset + sizeof(CaptureRecord) > end)
+            return nullptr;
+        const CaptureRecord* record = (const CaptureRecord*)(m_data + offset);
+        if (offset + sizeof(CaptureRecord) + record->length > end)
+            return nullptr; // truncated
+        return record;
+    }
+
+    const uint8_t*           m_data = nullptr;
+    size_t                   m_size = 0;
+    std::vector<std::string> m_devices;
+};
+
+
+/** Print per-device record counts, traffic and scan throughput for a capture. */
+int SummarizeCapture(const char* path) {
+    using clock = std::chrono::steady_clock;
+
+    auto t0 = clock::now();
+    CaptureReader reader;
+    if (!reader.Open(path)) {
+        printf("ERROR: Unable to open capture %s\n", path);
+        return -1;
+    }
+
+    struct DeviceStats {
+        uint64_t records[3][2] = {}; // [kind][sent]
+        uint64_t bytes = 0;
+        uint64_t failed = 0;
+    };
+    std::vector<DeviceStats> stats(reader.Devices().size() + 1); // last entry for unknown devices
+
+    uint64_t records = 0;
+    uint64_t lastTime = 0;
+    size_t scanned = sizeof(CaptureHeader);
+    for (const CaptureRecord* record = reader.First(); record; record = reader.Next(record)) {
+        DeviceStats& s = stats[(record->device < stats.size() - 1) ? record->device : stats.size() - 1];
+        s.records[record->kind % 3][record->flags & CAPTURE_SENT]++;
+        s.bytes += record->length;
+        if (record->flags & CAPTURE_FAILED)
+            s.failed++;
+        lastTime = record->time;
+        records++;
+        scanned += sizeof(CaptureRecord) + (record->length + 7) / 8 * 8;
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+
+    printf("%s: %llu records over %.3f s\n", path, (unsigned long long)records, lastTime / 1e9);
+    if (records != reader.Header().recordCount)
+        printf("WARNING: Header states %llu records.\n", (unsigned long long)reader.Header().recordCount);
+
+    for (size_t i = 0; i < stats.size(); i++) {
+        const DeviceStats& s = stats[i];
+        if (i == stats.size() - 1) {
+            if (!s.bytes)
+                break;
+            printf("<unknown device>\n");
+        } else {
+            printf("%s\n", reader.Devices()[i].c_str());
+        }
+        printf("  input received %llu, output sent %llu, feature sent %llu, feature received %llu, failed %llu, %llu bytes\n",
+            (unsigned long long)s.records[0][0], (unsigned long long)s.records[1][1], (unsigned long long)s.records[2][1], (unsigned long long)s.records[2][0],
+            (unsigned long long)s.failed, (unsigned long long)s.bytes);
+    }
+
+    printf("Scanned %zu bytes in %.3f ms (%.2f GB/s)\n", scanned, elapsed * 1e3, (elapsed > 0) ? scanned / elapsed / 1e9 : 0.0);
+    return 0;
+}
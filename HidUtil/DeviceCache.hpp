@@ -0,0 +1,102 @@
+#pragma once
+#include <windows.h>
+#include <cfgmgr32.h>
+#include <devpkey.h>
+#include <Shlobj.h>
+
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <string>
+
+
+/** Persistent cache of HID attributes and caps keyed by interface path and container ID.
+    Enables FindDevices to reject non-matching devices without opening them.
+    The container ID changes if a different physical device appears under the same interface path. */
+class DeviceCache {
+public:
+    struct Entry {
+        USHORT VendorID = 0;
+        USHORT ProductID = 0;
+        USHORT Usage = 0;
+        USHORT UsagePage = 0;
+    };
+
+    /** Load cache from %LOCALAPPDATA%\HidUtil\DeviceCache.txt. Missing file gives an empty cache. */
+    void Load() {
+        FILE* file = nullptr;
+        if (_wfopen_s(&file, FilePath().c_str(), L"r, ccs=UTF-8") || !file)
+            return;
+
+        wchar_t key[1024] = {};
+        Entry e;
+        while (fwscanf_s(file, L"%1023[^\t]\t%hx\t%hx\t%hx\t%hx\n", key, (unsigned)std::size(key), &e.VendorID, &e.ProductID, &e.Usage, &e.UsagePage) == 5)
+            m_entries[key] = e;
+
+        fclose(file);
+    }
+
+    /** Store cache. Entries for interfaces that were not seen since Load are dropped. */
+    void Save() const {
+        std::wstring path = FilePath();
+        CreateDirectoryW(path.substr(0, path.rfind(L'\\')).c_str(), NULL); // ignore errors
+
+        FILE* file = nullptr;
+        if (_wfopen_s(&file, path.c_str(), L"w, ccs=UTF-8") || !file)
+            return;
+
+        for (auto& [key, e] : m_seen)
+            fwprintf_s(file, L"%s\t%hx\t%hx\t%hx\t%hx\n", key.c_str(), e.VendorID, e.ProductID, e.Usage, e.UsagePage);
+
+        fclose(file);
+    }
+
+    /** Returns cached entry for key, or nullptr if not cached. */
+    const Entry* Find(const std::wstring& key) const {
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
+            return nullptr;
+        return &it->second;
+    }
+
+    /** Mark entry as seen in the current enumeration (not thread-safe). */
+    void Update(const std::wstring& key, const Entry& e) {
+        m_seen[key] = e;
+    }
+
+    /** Cache key for an interface: "<interface path>|<container ID>".
+        Returns empty string if the container ID cannot be determined. */
+    static std::wstring Key(const wchar_t* deviceInterface) {
+        wchar_t instanceId[MAX_DEVICE_ID_LEN] = {};
+        DEVPROPTYPE type = 0;
+        ULONG size = sizeof(instanceId);
+        if (CM_Get_Device_Interface_PropertyW(deviceInterface, &DEVPKEY_Device_InstanceId, &type, (BYTE*)instanceId, &size, 0) != CR_SUCCESS)
+            return {};
+
+        DEVINST devInst = 0;
+        if (CM_Locate_DevNodeW(&devInst, instanceId, CM_LOCATE_DEVNODE_NORMAL) != CR_SUCCESS)
+            return {};
+
+        GUID containerId = {};
+        size = sizeof(containerId);
+        if (CM_Get_DevNode_PropertyW(devInst, &DEVPKEY_Device_ContainerId, &type, (BYTE*)&containerId, &size, 0) != CR_SUCCESS)
+            return {};
+
+        wchar_t containerStr[40] = {};
+        StringFromGUID2(containerId, containerStr, (int)std::size(containerStr));
+        return std::wstring(deviceInterface) + L"|" + containerStr;
+    }
+
+private:
+    static std::wstring FilePath() {
+        std::wstring result;
+        wchar_t* folder = nullptr;
+        if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, NULL, &folder)))
+            result = std::wstring(folder) + L"\\HidUtil\\DeviceCache.txt";
+        CoTaskMemFree(folder);
+        return result;
+    }
+
+    std::map<std::wstring, Entry> m_entries; // loaded from file
+    std::map<std::wstring, Entry> m_seen;    // seen in current enumeration
+};
@@ -4,8 +4,12 @@
 #include <Hidclass.h> // combine with INITGUID define
 #include <hidsdi.h>
 #include <wrl/wrappers/corewrappers.h>
+#include "DeviceCache.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <execution>
+#include <numeric>
 #include <string>
 #include <vector>
 
@@ -51,6 +55,7 @@ public:
         USHORT ProductID = 0;
         USHORT Usage = 0;
         USHORT UsagePage = 0;
+        DWORD FileFlags = 0; // CreateFile flags (e.g. FILE_FLAG_OVERLAPPED)
     };
 
     struct Match {
@@ -60,7 +65,11 @@ public:
         HIDP_CAPS caps = {};
     };
 
-    static std::vector<Match> FindDevices (const Query& query) {
+    class Session; // defined in Session.hpp
+
+    /** Find devices matching query. Interfaces are checked in parallel on the thread pool.
+        If a cache is provided, devices with cached attributes that don't match are skipped without being opened. */
+    static std::vector<Match> FindDevices (const Query& query, DeviceCache* cache = nullptr) {
         const ULONG searchScope = CM_GET_DEVICE_INTERFACE_LIST_PRESENT; // only currently 'live' device interfaces
 
         ULONG deviceInterfaceListLength = 0;
@@ -72,24 +81,70 @@ public:
         cr = CM_Get_Device_Interface_ListW((GUID*)&GUID_DEVINTERFACE_HID, NULL, deviceInterfaceList.data(), deviceInterfaceListLength, searchScope);
         assert(cr == CR_SUCCESS);
 
+        std::vector<const wchar_t*> interfaces;
+        for (const wchar_t * currentInterface = deviceInterfaceList.c_str(); *currentInterface; currentInterface += wcslen(currentInterface) + 1)
+            interfaces.push_back(currentInterface);
+
+        struct Candidate {
+            Match match;
+            std::wstring key;        // cache key (empty if not cacheable)
+            DeviceCache::Entry attr; // attributes to store in cache
+            bool attrValid = false;
+        };
+        std::vector<Candidate> candidates(interfaces.size());
+
+        std::vector<size_t> indices(interfaces.size());
+        std::iota(indices.begin(), indices.end(), (size_t)0);
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t idx) {
+            Candidate& c = candidates[idx];
+            if (cache) {
+                c.key = DeviceCache::Key(interfaces[idx]);
+                const DeviceCache::Entry* cached = c.key.empty() ? nullptr : cache->Find(c.key);
+                if (cached) {
+                    c.attr = *cached;
+                    c.attrValid = true;
+                    if (!IsMatch(query, *cached))
+                        return; // skip without opening
+                }
+            }
+
+            c.match = CheckDevice(interfaces[idx], query, c.attr, c.attrValid);
+        });
+
         std::vector<Match> results;
-        for (const wchar_t * currentInterface = deviceInterfaceList.c_str(); *currentInterface; currentInterface += wcslen(currentInterface) + 1) {
-            auto result = CheckDevice(currentInterface, query);
-            if (!result.name.empty())
-                results.push_back(std::move(result));
+        for (Candidate& c : candidates) {
+            if (cache && c.attrValid && !c.key.empty())
+                cache->Update(c.key, c.attr);
+
+            if (!c.match.name.empty())
+                results.push_back(std::move(c.match));
         }
 
         return results;
     }
 
 private:
-    static Match CheckDevice(const wchar_t* deviceName, const Query& query) {
+    static bool IsMatch(const Query& query, const DeviceCache::Entry& attr) {
+        if (query.VendorID && (query.VendorID != attr.VendorID))
+            return false;
+        if (query.ProductID && (query.ProductID != attr.ProductID))
+            return false;
+
+        if (query.Usage && (query.Usage != attr.Usage))
+            return false;
+        if (query.UsagePage && (query.UsagePage != attr.UsagePage))
+            return false;
+
+        return true;
+    }
+
+    static Match CheckDevice(const wchar_t* deviceName, const Query& query, DeviceCache::Entry& attrOut, bool& attrValid) {
         FileHandle hid_dev(CreateFileW(deviceName,
             GENERIC_READ | GENERIC_WRITE,
             FILE_SHARE_READ | FILE_SHARE_WRITE,
             NULL,
             OPEN_EXISTING,
-            0,
+            query.FileFlags,
             NULL));
         if (!hid_dev.IsValid()) {
             DWORD err = GetLastError(); err;
@@ -99,26 +154,24 @@ private:
             return Match();
         }
 
+        // the device might disappear while being checked (e.g. during hot-plug arrival)
         HIDD_ATTRIBUTES attr = {};
         if (!HidD_GetAttributes(hid_dev.Get(), &attr))
-            abort();
+            return Match();
 
         PreparsedData reportDesc(hid_dev.Get());
+        if (!reportDesc)
+            return Match();
 
         HIDP_CAPS caps = {};
         if (HidP_GetCaps(reportDesc, &caps) != HIDP_STATUS_SUCCESS)
-            abort();
+            return Match();
 
         //wprintf(L"Device %ls (VendorID=%x, ProductID=%x, Usage=%x, UsagePage=%x)\n", deviceName, attr.VendorID, attr.ProductID, caps.Usage, caps.UsagePage);
 
-        if (query.VendorID && (query.VendorID != attr.VendorID))
-            return Match();
-        if (query.ProductID && (query.ProductID != attr.ProductID))
-            return Match();
-
-        if (query.Usage && (query.Usage != caps.Usage))
-            return Match();
-        if (query.UsagePage && (query.UsagePage != caps.UsagePage))
+        attrOut = {attr.VendorID, attr.ProductID, caps.Usage, caps.UsagePage};
+        attrValid = true;
+        if (!IsMatch(query, attrOut))
             return Match();
 
         //wprintf(L"  Found matching device with VendorID=%x, ProductID=%x\n", attr.VendorID, attr.ProductID);
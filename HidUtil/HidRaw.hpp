@@ -0,0 +1,137 @@
+#pragma once
+#include "ReportCodec.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+/** RAII wrapper of file descriptors. */
+class FileDescriptor {
+public:
+    FileDescriptor() = default;
+
+    explicit FileDescriptor(int fd) : m_fd(fd) {
+    }
+    ~FileDescriptor() {
+        if (m_fd >= 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    FileDescriptor(FileDescriptor&& obj) noexcept {
+        std::swap(m_fd, obj.m_fd);
+    }
+    FileDescriptor& operator=(FileDescriptor&& obj) noexcept {
+        std::swap(m_fd, obj.m_fd);
+        return *this;
+    }
+
+    bool IsValid() const {
+        return m_fd >= 0;
+    }
+
+    int Get() const {
+        return m_fd;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+
+/** Linux hidraw counterpart of the HID device search class.
+    Device caps are derived from the raw report descriptor through ReportCodec instead of hid.dll preparsed data.
+    A hidraw node represents a whole HID interface, so a device matches if any of its top-level collections match. */
+class HidRaw {
+public:
+    struct Query {
+        uint16_t VendorID = 0;
+        uint16_t ProductID = 0;
+        uint16_t Usage = 0;
+        uint16_t UsagePage = 0;
+    };
+
+    struct Match {
+        std::string name;
+        FileDescriptor dev;
+        ReportCodec codec;
+        ReportCaps caps;
+    };
+
+    /** Find devices matching query among /dev/hidraw* nodes. */
+    static std::vector<Match> FindDevices(const Query& query) {
+        std::vector<std::string> names;
+        DIR* dir = opendir("/dev");
+        if (!dir)
+            return {};
+        while (dirent* entry = readdir(dir)) {
+            if (strncmp(entry->d_name, "hidraw", 6) == 0)
+                names.push_back(std::string("/dev/") + entry->d_name);
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+
+        std::vector<Match> results;
+        for (const std::string& name : names) {
+            Match match = CheckDevice(name, query);
+            if (!match.name.empty())
+                results.push_back(std::move(match));
+        }
+        return results;
+    }
+
+    /** Send feature report. The first byte is the report ID. */
+    static bool SetFeature(int fd, const uint8_t* report, size_t length) {
+        return ioctl(fd, HIDIOCSFEATURE(length), report) >= 0;
+    }
+
+    /** Retrieve feature report. The first byte must be set to the report ID. */
+    static bool GetFeature(int fd, uint8_t* report, size_t length) {
+        return ioctl(fd, HIDIOCGFEATURE(length), report) >= 0;
+    }
+
+private:
+    static Match CheckDevice(const std::string& name, const Query& query) {
+        FileDescriptor dev(open(name.c_str(), O_RDWR | O_CLOEXEC));
+        if (!dev.IsValid())
+            return Match(); // typically EACCES without udev rule
+
+        hidraw_devinfo info = {};
+        if (ioctl(dev.Get(), HIDIOCGRAWINFO, &info) < 0)
+            return Match();
+
+        if (query.VendorID && (query.VendorID != (uint16_t)info.vendor))
+            return Match();
+        if (query.ProductID && (query.ProductID != (uint16_t)info.product))
+            return Match();
+
+        int descSize = 0;
+        if (ioctl(dev.Get(), HIDIOCGRDESCSIZE, &descSize) < 0)
+            return Match();
+
+        hidraw_report_descriptor desc = {};
+        desc.size = (uint32_t)descSize;
+        if (ioctl(dev.Get(), HIDIOCGRDESC, &desc) < 0)
+            return Match();
+
+        Match match;
+        if (!match.codec.Parse(desc.value, desc.size))
+            return Match();
+
+        if (!match.codec.HasCollection(query.UsagePage, query.Usage))
+            return Match();
+
+        match.name = name;
+        match.dev = std::move(dev);
+        match.caps = match.codec.Caps();
+        return match;
+    }
+};
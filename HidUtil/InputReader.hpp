@@ -0,0 +1,135 @@
+#pragma once
+#include "HID.hpp"
+#include "RingBuffer.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+/** Input report with capture timestamp. */
+struct InputReport {
+    LARGE_INTEGER timestamp = {}; // QueryPerformanceCounter at completion
+    USHORT device = 0;            // index into devices passed to InputReader
+    USHORT length = 0;            // valid bytes in data
+    BYTE   data[64] = {};         // report data (truncated if longer)
+};
+
+
+/** Asynchronous input-report reader.
+    Keeps several overlapped ReadFile requests in flight per device, so that no reports are lost
+    between reads, and forwards completed reports through a lock-free ring buffer.
+    Devices must be opened with FILE_FLAG_OVERLAPPED. */
+class InputReader {
+public:
+    static constexpr unsigned int READS_PER_DEVICE = 8;
+
+    InputReader(std::vector<HID::Match>& devices, size_t ringCapacity = 16384) : m_ring(ringCapacity) {
+        m_port.Attach(CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1));
+
+        for (size_t i = 0; i < devices.size(); i++) {
+            HANDLE dev = devices[i].dev.Get();
+            if (!CreateIoCompletionPort(dev, m_port.Get(), i, 0)) {
+                wprintf(L"ERROR: CreateIoCompletionPort failed (err %u).\n", GetLastError());
+                continue;
+            }
+
+            for (unsigned int r = 0; r < READS_PER_DEVICE; r++) {
+                auto req = std::make_unique<ReadRequest>();
+                req->dev = dev;
+                req->device = (USHORT)i;
+                req->buffer.resize(devices[i].caps.InputReportByteLength);
+                m_requests.push_back(std::move(req));
+            }
+        }
+
+        for (auto& req : m_requests)
+            Issue(*req);
+
+        m_thread = std::thread(&InputReader::Run, this);
+    }
+
+    ~InputReader() {
+        m_stop = true; // reader thread cancels outstanding requests
+        m_thread.join();
+    }
+
+    /** Retrieve next captured report. Returns false if none is available. */
+    bool TryPop(InputReport& report) {
+        return m_ring.TryPop(report);
+    }
+
+    /** Number of reports lost due to a full ring buffer. */
+    size_t Dropped() const {
+        return m_dropped;
+    }
+
+private:
+    struct ReadRequest {
+        OVERLAPPED        overlapped = {};
+        HANDLE            dev = 0;
+        USHORT            device = 0;
+        std::vector<BYTE> buffer;
+        bool              pending = false;
+    };
+
+    void Issue(ReadRequest& req) {
+        req.overlapped = {};
+        BOOL ok = ReadFile(req.dev, req.buffer.data(), (DWORD)req.buffer.size(), NULL, &req.overlapped);
+        req.pending = ok || (GetLastError() == ERROR_IO_PENDING);
+        if (req.pending)
+            m_pending++;
+        else
+            wprintf(L"ERROR: ReadFile failed (err %u).\n", GetLastError());
+    }
+
+    /** Reader thread. Drains completions until stopped and all requests are completed. */
+    void Run() {
+        OVERLAPPED_ENTRY entries[32] = {};
+        bool cancelled = false;
+        while (m_pending > 0) {
+            if (m_stop && !cancelled) {
+                // cancel from this thread, so that no request is reissued afterwards
+                for (auto& req : m_requests) {
+                    if (req->pending)
+                        CancelIoEx(req->dev, &req->overlapped);
+                }
+                cancelled = true;
+            }
+
+            ULONG count = 0;
+            if (!GetQueuedCompletionStatusEx(m_port.Get(), entries, (ULONG)std::size(entries), &count, 100, FALSE))
+                continue; // timeout
+
+            LARGE_INTEGER now = {};
+            QueryPerformanceCounter(&now);
+
+            for (ULONG i = 0; i < count; i++) {
+                ReadRequest* req = CONTAINING_RECORD(entries[i].lpOverlapped, ReadRequest, overlapped);
+                req->pending = false;
+                m_pending--;
+
+                DWORD length = 0;
+                if (GetOverlappedResult(req->dev, &req->overlapped, &length, FALSE)) {
+                    InputReport report;
+                    report.timestamp = now;
+                    report.device = req->device;
+                    report.length = (USHORT)((length < sizeof(report.data)) ? length : sizeof(report.data));
+                    memcpy(report.data, req->buffer.data(), report.length);
+                    if (!m_ring.TryPush(report))
+                        m_dropped++;
+                }
+
+                if (!m_stop)
+                    Issue(*req);
+            }
+        }
+    }
+
+    Microsoft::WRL::Wrappers::Event           m_port; // generic HANDLE RAII wrapper
+    std::vector<std::unique_ptr<ReadRequest>> m_requests;
+    RingBuffer<InputReport>                   m_ring;
+    size_t                                    m_pending = 0; // only accessed by constructor & reader thread
+    std::atomic<size_t>                       m_dropped = 0;
+    std::atomic<bool>                         m_stop = false;
+    std::thread                               m_thread;
+};
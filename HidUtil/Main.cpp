@@ -1,44 +1,475 @@
 #include "HID.hpp"
+#include "InputReader.hpp"
+#include "Session.hpp"
+#include "Stats.hpp"
+#include "Stream.hpp"
 #include "TailLight.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+
+/** Measure device enumeration time without (cold) and with (warm) attribute cache. */
+int EnumBenchmark(const HID::Query& query) {
+    using clock = std::chrono::steady_clock;
+
+    DeviceCache cache; // empty cache
+    auto t0 = clock::now();
+    size_t coldCount = HID::FindDevices(query, &cache).size();
+    auto t1 = clock::now();
+    cache.Save();
+
+    DeviceCache warmCache;
+    warmCache.Load();
+    auto t2 = clock::now();
+    size_t warmCount = HID::FindDevices(query, &warmCache).size();
+    auto t3 = clock::now();
+
+    wprintf(L"Cold enumeration: %.2f ms (%zu matches)\n", std::chrono::duration<double, std::milli>(t1 - t0).count(), coldCount);
+    wprintf(L"Warm enumeration: %.2f ms (%zu matches)\n", std::chrono::duration<double, std::milli>(t3 - t2).count(), warmCount);
+    return 0;
+}
+
+
+/** Measure sustained tail-light color updates per second with prepared writers. */
+int ColorBenchmark(const HID::Query& query, double seconds) {
+    using clock = std::chrono::steady_clock;
+
+    auto matches = HID::FindDevices(query);
+    std::vector<TailLightWriter> writers;
+    for (HID::Match& match : matches) {
+        TailLightWriter writer(match.dev.Get(), match.report, match.caps);
+        if (writer.IsValid())
+            writers.push_back(writer);
+    }
+    if (writers.empty()) {
+        wprintf(L"No matching devices found.\n");
+        return -3;
+    }
+
+    size_t updates = 0;
+    auto start = clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    while (clock::now() < end) {
+        // cycle through dim colors to stay within the driver power budget
+        BYTE level = (BYTE)(updates & 0x3F);
+        for (TailLightWriter& writer : writers) {
+            if (!writer.Set(RGB(level, 0x3F - level, 0)))
+                return -2;
+        }
+        updates++;
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+    wprintf(L"%zu updates to %zu device(s) in %.2f s: %.1f updates/s per device\n", updates, writers.size(), elapsed, updates/elapsed);
+    return 0;
+}
+
+
+/** Measure latency distributions of feature and input report requests on all matched devices.
+    Writes a dim color, so that the driver power budget doesn't interfere. */
+int Bench(const HID::Query& query, const BenchConfig& config, const char* jsonPath) {
+    FILE* log = (jsonPath && !strcmp(jsonPath, "-")) ? stderr : stdout; // keep stdout pure JSON
+    if ((config.cpu >= 0) && !PinCurrentThread(config.cpu))
+        fwprintf(log, L"WARNING: Unable to pin thread to CPU %d.\n", config.cpu);
+
+    auto matches = HID::FindDevices(query);
+    std::vector<BenchResult> results;
+    for (HID::Match& match : matches) {
+        if (match.caps.FeatureReportByteLength != sizeof(TailLightReport))
+            continue;
+
+        ReportCodec codec;
+        TailLightLayout layout;
+        if (codec.Compile(match.report, match.caps))
+            layout.Init(codec);
+        else
+            layout.InitFixed();
+
+        HANDLE dev = match.dev.Get();
+        std::string name = CaptureWriter::ToUtf8(match.name);
+        layout.SetColor(0x20, 0x20, 0x20);
+        std::vector<BYTE> setReport(layout.Report());
+        std::vector<BYTE> getReport(match.caps.FeatureReportByteLength, (BYTE)0);
+        std::vector<BYTE> inputReport(match.caps.InputReportByteLength, (BYTE)0);
+
+        fwprintf(log, L"Benchmarking %s...\n", match.name.c_str());
+        results.push_back({name, "SetFeature", LatencyStats(), 0});
+        results.back().stats = Measure(config.warmup, config.iterations, results.back().failures, [&] {
+            return HidD_SetFeature(dev, setReport.data(), (ULONG)setReport.size()) != FALSE;
+        });
+
+        results.push_back({name, "GetFeature", LatencyStats(), 0});
+        results.back().stats = Measure(config.warmup, config.iterations, results.back().failures, [&] {
+            getReport[0] = setReport[0]; // report ID
+            return HidD_GetFeature(dev, getReport.data(), (ULONG)getReport.size()) != FALSE;
+        });
+
+        results.push_back({name, "GetInputReport", LatencyStats(), 0});
+        results.back().stats = Measure(config.warmup, config.iterations, results.back().failures, [&] {
+            inputReport[0] = 0x27; // ReportID 39 (same as TailLightWriter::Probe)
+            return HidD_GetInputReport(dev, inputReport.data(), (ULONG)inputReport.size()) != FALSE;
+        });
+    }
+    if (results.empty()) {
+        fwprintf(log, L"No matching devices found.\n");
+        return -3;
+    }
+
+    fflush(log);
+    PrintBenchReport(log, results);
+    if (jsonPath) {
+        FILE* out = stdout;
+        if (strcmp(jsonPath, "-") && fopen_s(&out, jsonPath, "w")) {
+            fwprintf(log, L"ERROR: Unable to create %hs\n", jsonPath);
+            return -1;
+        }
+        WriteBenchJson(out, config, results);
+        if (out != stdout)
+            fclose(out);
+    }
+    return 0;
+}
+
+
+/** Capture input reports from all matched devices and report per-device rates.
+    Reports are also recorded to "capture" if specified. */
+int Capture(HID::Query query, double seconds, CaptureWriter* capture) {
+    query.FileFlags = FILE_FLAG_OVERLAPPED;
+    auto matches = HID::FindDevices(query);
+    if (matches.empty()) {
+        wprintf(L"No matching devices found.\n");
+        return -3;
+    }
+
+    std::vector<size_t> counts(matches.size(), 0);
+    LARGE_INTEGER freq = {};
+    QueryPerformanceFrequency(&freq);
+
+    std::vector<uint16_t> captureDevices;
+    for (HID::Match& match : matches)
+        captureDevices.push_back(capture ? capture->AddDevice(match.name) : 0);
+    LARGE_INTEGER first = {}, last = {};
+    size_t total = 0;
+    size_t dropped = 0;
+    {
+        InputReader reader(matches);
+        wprintf(L"Capturing input reports for %.1f s...\n", seconds);
+
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+        while (std::chrono::steady_clock::now() < end) {
+            InputReport report;
+            if (!reader.TryPop(report)) {
+                Sleep(1);
+                continue;
+            }
+
+            if (total == 0)
+                first = report.timestamp;
+            last = report.timestamp;
+            counts[report.device]++;
+            total++;
+
+            if (capture) {
+                // convert to steady_clock time, which is also based on QueryPerformanceCounter
+                LONGLONG ticks = report.timestamp.QuadPart;
+                uint64_t ns = (uint64_t)(ticks / freq.QuadPart) * 1000000000ull + (uint64_t)(ticks % freq.QuadPart) * 1000000000ull / freq.QuadPart;
+                capture->Write(ns, captureDevices[report.device], HidP_Input, 0, report.data, report.length);
+            }
+        }
+        dropped = reader.Dropped();
+    }
+
+    double span = (double)(last.QuadPart - first.QuadPart) / freq.QuadPart;
+    for (size_t i = 0; i < matches.size(); i++)
+        wprintf(L"%s: %zu reports (%.1f Hz)\n", matches[i].name.c_str(), counts[i], (span > 0) ? counts[i]/span : 0.0);
+    wprintf(L"Total: %zu reports, %zu dropped due to full ring buffer.\n", total, dropped);
+    return 0;
+}
+
+
+/** Re-issue the feature and output reports sent in a capture with the original timing.
+    Reports that failed during capture are skipped, since the device never accepted them.
+    Captured devices are mapped to matched devices by name, or else by position. */
+int Replay(const HID::Query& query, const char* path) {
+    using clock = std::chrono::steady_clock;
+    using ms = std::chrono::duration<double, std::milli>;
+
+    CaptureReader reader;
+    if (!reader.Open(path)) {
+        wprintf(L"ERROR: Unable to open capture %hs\n", path);
+        return -1;
+    }
+
+    auto matches = HID::FindDevices(query);
+    if (matches.empty()) {
+        wprintf(L"No matching devices found.\n");
+        return -3;
+    }
+
+    std::vector<HANDLE> targets;
+    for (size_t i = 0; i < reader.Devices().size(); i++) {
+        HANDLE target = matches[i % matches.size()].dev.Get();
+        for (HID::Match& match : matches) {
+            if (CaptureWriter::ToUtf8(match.name) == reader.Devices()[i])
+                target = match.dev.Get();
+        }
+        targets.push_back(target);
+    }
+
+    FrameTimer timer;
+    size_t sent = 0;
+    size_t failures = 0;
+    size_t skipped = 0; // failed during capture
+    double driftSum = 0;  // in ms
+    double driftMax = 0;  // in ms
+
+    clock::time_point start = clock::now();
+    uint64_t firstTime = 0;
+    std::vector<BYTE> report;
+    for (const CaptureRecord* record = reader.First(); record; record = reader.Next(record)) {
+        if (!(record->flags & CAPTURE_SENT) || (record->kind == HidP_Input) || (record->device >= targets.size()))
+            continue; // only reports sent to the device can be re-issued
+        if (record->flags & CAPTURE_FAILED) {
+            skipped++;
+            continue;
+        }
+
+        if (sent == 0)
+            firstTime = record->time;
+        clock::time_point deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(record->time - firstTime));
+        timer.WaitUntil(deadline);
+        double drift = ms(clock::now() - deadline).count();
+        driftSum += drift;
+        if (drift > driftMax)
+            driftMax = drift;
+
+        report.assign(CaptureReader::Data(record), CaptureReader::Data(record) + record->length);
+        BOOLEAN ok = FALSE;
+        if (record->kind == HidP_Feature)
+            ok = HidD_SetFeature(targets[record->device], report.data(), (ULONG)report.size());
+        else
+            ok = HidD_SetOutputReport(targets[record->device], report.data(), (ULONG)report.size());
+        if (!ok)
+            failures++;
+        sent++;
+    }
+
+    wprintf(L"Replayed %zu reports to %zu device(s). %zu failures, %zu skipped that failed during capture.\n", sent, matches.size(), failures, skipped);
+    if (sent)
+        wprintf(L"Drift: mean %.3f ms, max %.3f ms\n", driftSum/sent, driftMax);
+    return failures ? -2 : 0;
+}
+
+
+/** Print the current color of all matched devices. */
+int GetColors(const HID::Query& query) {
+    auto matches = HID::FindDevices(query);
+    if (matches.empty()) {
+        wprintf(L"No matching devices found.\n");
+        return -3;
+    }
+
+    int res = 0;
+    for (HID::Match& match : matches) {
+        COLORREF color = 0;
+        if (!GetTailLight(match.dev.Get(), match.report, match.caps, color)) {
+            wprintf(L"%s: readback failed\n", match.name.c_str());
+            res = -2;
+            continue;
+        }
+        wprintf(L"%s: %u %u %u\n", match.name.c_str(), GetRValue(color), GetGValue(color), GetBValue(color));
+    }
+    return res;
+}
+
+
+/** Keep devices open and apply color to all current and later plugged-in devices. */
+int Watch(const HID::Query& query, COLORREF color) {
+    DeviceCache cache;
+    cache.Load();
+    HID::Session session(query, &cache);
+    cache.Save();
+
+    wprintf(L"Watching for devices. Press ENTER to exit.\n");
+    std::atomic<bool> done = false;
+    std::thread input([&done] {
+        std::cin.get();
+        done = true;
+    });
+
+    unsigned int applied = (unsigned int)-1; // generation last applied
+    while (!done) {
+        unsigned int generation = session.Generation();
+        if (generation != applied) {
+            wprintf(L"%zu matching device(s) open.\n", session.Count());
+            session.ForEach([color](HID::Match& match) {
+                UpdateTailLight(match.dev.Get(), match.report, match.caps, color);
+            });
+            applied = generation;
+        }
+
+        Sleep(100);
+    }
+
+    input.join();
+    return 0;
+}
 
 
 int main(int argc, char* argv[]) {
+    HID::Query query;
+    query.VendorID = 0x045E;  // Microsoft
+    query.ProductID = 0x082A; // Pro IntelliMouse
+    query.Usage = 0x0212;     //
+    query.UsagePage = 0xFF07; //
+
+    CaptureWriter capture;
+    CaptureWriter* captureOut = nullptr;
+    if ((argc >= 3) && (strcmp(argv[1], "--capture") == 0)) {
+        if (!capture.Open(argv[2])) {
+            wprintf(L"ERROR: Unable to create capture %hs\n", argv[2]);
+            return -1;
+        }
+        captureOut = &capture;
+        argc -= 2; // skip option (argv[0] is unused)
+        argv += 2;
+    }
+
+    if ((argc >= 2) && (strcmp(argv[1], "enumbench") == 0))
+        return EnumBenchmark(query);
+    if ((argc >= 2) && (strcmp(argv[1], "colorbench") == 0))
+        return ColorBenchmark(query, (argc >= 3) ? atof(argv[2]) : 5.0);
+    if ((argc >= 2) && (strcmp(argv[1], "bench") == 0)) {
+        BenchConfig config;
+        const char* jsonPath = nullptr;
+        for (int i = 2; i < argc; i++) {
+            if ((strcmp(argv[i], "--warmup") == 0) && (i + 1 < argc))
+                config.warmup = atoi(argv[++i]);
+            else if ((strcmp(argv[i], "--cpu") == 0) && (i + 1 < argc))
+                config.cpu = atoi(argv[++i]);
+            else if ((strcmp(argv[i], "--json") == 0) && (i + 1 < argc))
+                jsonPath = argv[++i];
+            else
+                config.iterations = atoi(argv[i]);
+        }
+        return Bench(query, config, jsonPath);
+    }
+    if ((argc >= 2) && (strcmp(argv[1], "capture") == 0)) {
+        if (argc >= 5) {
+            // override top-level collection (hex)
+            query.UsagePage = (USHORT)strtoul(argv[3], nullptr, 16);
+            query.Usage = (USHORT)strtoul(argv[4], nullptr, 16);
+        }
+        return Capture(query, (argc >= 3) ? atof(argv[2]) : 5.0, captureOut);
+    }
+    if ((argc >= 2) && (strcmp(argv[1], "stream") == 0)) {
+        const char* path = nullptr;
+        unsigned int verifyInterval = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--verify") == 0) {
+                if (i + 1 >= argc) {
+                    wprintf(L"ERROR: --verify requires an interval.\n");
+                    return -1;
+                }
+                verifyInterval = atoi(argv[++i]);
+            } else if (!path) {
+                path = argv[i];
+            } else {
+                wprintf(L"ERROR: Unexpected argument %hs\n", argv[i]);
+                return -1;
+            }
+        }
+
+        FILE* input = stdin;
+        if (path && fopen_s(&input, path, "r")) {
+            wprintf(L"ERROR: Unable to open %hs\n", path);
+            return -1;
+        }
+        int res = StreamColors(query, input, captureOut, verifyInterval);
+        if (input != stdin)
+            fclose(input);
+        return res;
+    }
+    if ((argc >= 2) && (strcmp(argv[1], "get") == 0))
+        return GetColors(query);
+    if ((argc >= 3) && (strcmp(argv[1], "replay") == 0))
+        return Replay(query, argv[2]);
+    if ((argc >= 3) && (strcmp(argv[1], "summary") == 0))
+        return SummarizeCapture(argv[2]);
+    if ((argc >= 5) && (strcmp(argv[1], "watch") == 0))
+        return Watch(query, RGB(atoi(argv[2]), atoi(argv[3]), atoi(argv[4])));
+
     if (argc < 4) {
         wprintf(L"IntelliMouse tail-light shifter.\n");
         wprintf(L"Usage: \"HidUtil.exe <red> <green> <blue>\" (example: \"HidUtil.exe 0 0 255\").\n");
+        wprintf(L"       \"HidUtil.exe enumbench\" to measure cold and warm device enumeration time.\n");
+        wprintf(L"       Append \"--probe\" to read back an input report after the update (diagnostic),\n");
+        wprintf(L"       \"--verify\" to read back the color after the update,\n");
+        wprintf(L"       or \"--if-changed\" to skip devices that already show the color.\n");
+        wprintf(L"       \"HidUtil.exe colorbench [seconds]\" to measure sustained color updates per second.\n");
+        wprintf(L"       \"HidUtil.exe bench [iterations] [--warmup N] [--cpu N] [--json file|-]\" to measure report request latency.\n");
+        wprintf(L"       \"HidUtil.exe capture [seconds] [usagePage usage]\" to capture input reports with overlapped reads.\n");
+        wprintf(L"       \"HidUtil.exe stream [file] [--verify N]\" to stream \"<red> <green> <blue> <delay_ms>\" lines from file or stdin.\n");
+        wprintf(L"       \"HidUtil.exe get\" to read back the current color.\n");
+        wprintf(L"       \"HidUtil.exe replay <file>\" to re-issue the reports sent in a capture with the original timing.\n");
+        wprintf(L"       \"HidUtil.exe summary <file>\" to summarize a capture.\n");
+        wprintf(L"       \"HidUtil.exe watch <red> <green> <blue>\" to keep updating devices as they are plugged in.\n");
+        wprintf(L"       Prefix with \"--capture <file>\" to record sent and received reports (set, capture and stream).\n");
         return -1;
     }
 
     auto red = (BYTE)atoi(argv[1]);
     auto green = (BYTE)atoi(argv[2]);
     auto blue = (BYTE)atoi(argv[3]);
-
-    HID::Query query;
-    query.VendorID = 0x045E;  // Microsoft
-    query.ProductID = 0x082A; // Pro IntelliMouse
-    query.Usage = 0x0212;     //
-    query.UsagePage = 0xFF07; //
+    COLORREF color = RGB(red, green, blue);
+    bool probe = false;
+    bool verify = false;
+    bool ifChanged = false;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--probe") == 0)
+            probe = true;
+        else if (strcmp(argv[i], "--verify") == 0)
+            verify = true;
+        else if (strcmp(argv[i], "--if-changed") == 0)
+            ifChanged = true;
+    }
 
     wprintf(L"Searching for matching HID devices...\n");
-    auto matches = HID::FindDevices(query);
+    DeviceCache cache;
+    cache.Load();
+    auto matches = HID::FindDevices(query, &cache);
+    cache.Save();
     if (matches.empty()) {
         wprintf(L"No matching devices found.\n");
         return -3;
     }
 
     for (HID::Match& match : matches) {
-#if 0
         COLORREF cur_color = 0;
-        if (GetTailLight(match.dev.Get(), cur_color)) {
-            wprintf(L"Current color: %u\n", cur_color);
+        if (ifChanged && GetTailLight(match.dev.Get(), match.report, match.caps, cur_color) && (cur_color == color)) {
+            wprintf(L"Skipping %s (already shows requested color).\n", match.name.c_str());
+            continue;
         }
-#endif
 
         wprintf(L"Updating %s\n", match.name.c_str());
-        bool ok = UpdateTailLight(match.dev.Get(), match.report, match.caps, RGB(red, green, blue));
+        bool ok = UpdateTailLight(match.dev.Get(), match.report, match.caps, color, probe, captureOut, captureOut ? captureOut->AddDevice(match.name) : 0);
         if (!ok)
             return -2;
 
+        if (verify) {
+            if (!GetTailLight(match.dev.Get(), match.report, match.caps, cur_color)) {
+                wprintf(L"ERROR: Unable to read back color.\n");
+                return -2;
+            }
+            if (cur_color != color) {
+                // can be caused by the filter driver power budget
+                wprintf(L"ERROR: Device shows color (%u,%u,%u).\n", GetRValue(cur_color), GetGValue(cur_color), GetBValue(cur_color));
+                return -2;
+            }
+        }
+
         wprintf(L"SUCCESS: Tail-light color updated.\n");
     }
 
@@ -0,0 +1,313 @@
+/* Linux build of HidUtil on top of /dev/hidraw*.
+   Build: g++ -std=c++17 -O2 -pthread -o hidutil MainLinux.cpp
+   Requires read/write access to the hidraw nodes (and /dev/uhid for "selftest"). */
+#include "CaptureFile.hpp"
+#include "HidRaw.hpp"
+#include "Stats.hpp"
+#include "TailLightLayout.hpp"
+#include <linux/uhid.h>
+#include <poll.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+
+/** Set tail-light color on all matched devices. */
+int SetColor(const HidRaw::Query& query, uint8_t red, uint8_t green, uint8_t blue) {
+    printf("Searching for matching HID devices...\n");
+    auto matches = HidRaw::FindDevices(query);
+    if (matches.empty()) {
+        printf("No matching devices found.\n");
+        return -3;
+    }
+
+    for (HidRaw::Match& match : matches) {
+        TailLightLayout layout;
+        if (!layout.Init(match.codec))
+            continue;
+
+        printf("Updating %s\n", match.name.c_str());
+        layout.SetColor(red, green, blue);
+        if (!HidRaw::SetFeature(match.dev.Get(), layout.Report().data(), layout.Report().size())) {
+            printf("ERROR: HIDIOCSFEATURE failure (err %d).\n", errno);
+            return -2;
+        }
+
+        printf("SUCCESS: Tail-light color updated.\n");
+    }
+    return 0;
+}
+
+
+/** Measure latency distributions of feature and input report requests on all matched devices. */
+int Bench(const HidRaw::Query& query, const BenchConfig& config, const char* jsonPath) {
+    FILE* log = (jsonPath && !strcmp(jsonPath, "-")) ? stderr : stdout; // keep stdout pure JSON
+    if ((config.cpu >= 0) && !PinCurrentThread(config.cpu))
+        fprintf(log, "WARNING: Unable to pin thread to CPU %d.\n", config.cpu);
+
+    auto matches = HidRaw::FindDevices(query);
+    std::vector<BenchResult> results;
+    for (HidRaw::Match& match : matches) {
+        TailLightLayout layout;
+        if (!layout.Init(match.codec))
+            continue;
+
+        int dev = match.dev.Get();
+        layout.SetColor(0x20, 0x20, 0x20); // dim color within the driver power budget
+        std::vector<uint8_t> setReport(layout.Report());
+        std::vector<uint8_t> getReport(match.caps.FeatureReportByteLength, (uint8_t)0);
+
+        fprintf(log, "Benchmarking %s...\n", match.name.c_str());
+        results.push_back({match.name, "SetFeature", LatencyStats(), 0});
+        results.back().stats = Measure(config.warmup, config.iterations, results.back().failures, [&] {
+            return HidRaw::SetFeature(dev, setReport.data(), setReport.size());
+        });
+
+        results.push_back({match.name, "GetFeature", LatencyStats(), 0});
+        results.back().stats = Measure(config.warmup, config.iterations, results.back().failures, [&] {
+            getReport[0] = setReport[0]; // report ID
+            return HidRaw::GetFeature(dev, getReport.data(), getReport.size());
+        });
+
+#ifdef HIDIOCGINPUT // Linux 5.11 and newer
+        std::vector<uint8_t> inputReport(match.caps.InputReportByteLength, (uint8_t)0);
+        results.push_back({match.name, "GetInputReport", LatencyStats(), 0});
+        results.back().stats = Measure(config.warmup, config.iterations, results.back().failures, [&] {
+            inputReport[0] = 0x27; // ReportID 39 (same as TailLightWriter::Probe)
+            return ioctl(dev, HIDIOCGINPUT(inputReport.size()), inputReport.data()) >= 0;
+        });
+#endif
+    }
+    if (results.empty()) {
+        fprintf(log, "No matching devices found.\n");
+        return -3;
+    }
+
+    PrintBenchReport(log, results);
+    if (jsonPath) {
+        FILE* out = strcmp(jsonPath, "-") ? fopen(jsonPath, "w") : stdout;
+        if (!out) {
+            fprintf(log, "ERROR: Unable to create %s\n", jsonPath);
+            return -1;
+        }
+        WriteBenchJson(out, config, results);
+        if (out != stdout)
+            fclose(out);
+    }
+    return 0;
+}
+
+
+/** List all accessible hidraw devices with their caps. */
+int List() {
+    for (HidRaw::Match& match : HidRaw::FindDevices(HidRaw::Query())) {
+        const ReportCaps& caps = match.caps;
+        printf("%s\n", match.name.c_str());
+        for (uint32_t c : match.codec.Collections())
+            printf("  Collection UsagePage=0x%04X, Usage=0x%04X\n", c >> 16, c & 0xFFFF);
+        printf("  InputReportByteLength=%u, OutputReportByteLength=%u, FeatureReportByteLength=%u\n", caps.InputReportByteLength, caps.OutputReportByteLength, caps.FeatureReportByteLength);
+        printf("  NumberInputButtonCaps=%u, NumberInputValueCaps=%u\n", caps.NumberInputButtonCaps, caps.NumberInputValueCaps);
+        printf("  NumberOutputButtonCaps=%u, NumberOutputValueCaps=%u\n", caps.NumberOutputButtonCaps, caps.NumberOutputValueCaps);
+        printf("  NumberFeatureButtonCaps=%u, NumberFeatureValueCaps=%u\n", caps.NumberFeatureButtonCaps, caps.NumberFeatureValueCaps);
+    }
+    return 0;
+}
+
+
+/** Measure report descriptor parse throughput over a corpus of raw descriptor files
+    (e.g. copies of /sys/class/hidraw/hidrawN/device/report_descriptor). */
+int ParseBenchmark(int fileCount, char* files[], double seconds) {
+    using clock = std::chrono::steady_clock;
+
+    std::vector<std::vector<uint8_t>> corpus;
+    size_t corpusBytes = 0;
+    for (int i = 0; i < fileCount; i++) {
+        FILE* file = fopen(files[i], "rb");
+        if (!file) {
+            printf("ERROR: Unable to open %s\n", files[i]);
+            return -1;
+        }
+        std::vector<uint8_t> desc(HID_MAX_DESCRIPTOR_SIZE);
+        desc.resize(fread(desc.data(), 1, desc.size(), file));
+        fclose(file);
+
+        ReportCodec codec;
+        if (!codec.Parse(desc.data(), desc.size()))
+            printf("WARNING: %s is malformed\n", files[i]);
+        corpusBytes += desc.size();
+        corpus.push_back(std::move(desc));
+    }
+    if (corpus.empty()) {
+        printf("No descriptors specified.\n");
+        return -1;
+    }
+
+    ReportCodec codec;
+    size_t passes = 0;
+    size_t fields = 0;
+    auto start = clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    while (clock::now() < end) {
+        for (const std::vector<uint8_t>& desc : corpus) {
+            codec.Parse(desc.data(), desc.size());
+            fields += codec.Fields().size();
+        }
+        passes++;
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+    printf("%zu descriptors (%zu bytes), %zu passes in %.2f s\n", corpus.size(), corpusBytes, passes, elapsed);
+    printf("%.0f descriptors/s, %.1f MB/s (%zu fields)\n", passes*corpus.size()/elapsed, passes*corpusBytes/elapsed/1e6, fields);
+    return 0;
+}
+
+
+/** Create a virtual IntelliMouse tail-light device through uhid, set a color through hidraw,
+    and check that the device receives the expected feature report. */
+int SelfTest() {
+    // vendor collection with 72-byte feature report 0x24, like the Pro IntelliMouse
+    static const uint8_t descriptor[] = {
+        0x06, 0x07, 0xFF, // Usage Page (0xFF07)
+        0x0A, 0x12, 0x02, // Usage (0x0212)
+        0xA1, 0x01,       // Collection (Application)
+        0x85, 0x24,       //   Report ID (0x24)
+        0x0A, 0x12, 0x02, //   Usage (0x0212)
+        0x15, 0x00,       //   Logical Minimum (0)
+        0x26, 0xFF, 0x00, //   Logical Maximum (255)
+        0x75, 0x08,       //   Report Size (8)
+        0x95, 0x48,       //   Report Count (72)
+        0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
+        0xC0,             // End Collection
+    };
+    const uint16_t vendorId = 0x045E;
+    const uint16_t productId = 0xF82A; // not a real product, to avoid matching physical mice
+
+    FileDescriptor uhid(open("/dev/uhid", O_RDWR | O_CLOEXEC));
+    if (!uhid.IsValid()) {
+        printf("ERROR: Unable to open /dev/uhid (err %d).\n", errno);
+        return -1;
+    }
+
+    uhid_event ev = {};
+    ev.type = UHID_CREATE2;
+    strcpy((char*)ev.u.create2.name, "HidUtil selftest");
+    memcpy(ev.u.create2.rd_data, descriptor, sizeof(descriptor));
+    ev.u.create2.rd_size = sizeof(descriptor);
+    ev.u.create2.bus = BUS_USB;
+    ev.u.create2.vendor = vendorId;
+    ev.u.create2.product = productId;
+    if (write(uhid.Get(), &ev, sizeof(ev)) != sizeof(ev)) {
+        printf("ERROR: UHID_CREATE2 failure (err %d).\n", errno);
+        return -1;
+    }
+
+    // answer SET_REPORT requests from the kernel
+    std::atomic<bool> done = false;
+    std::vector<uint8_t> received;
+    std::thread device([&] {
+        while (!done) {
+            pollfd pfd = {uhid.Get(), POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0)
+                continue;
+
+            uhid_event req = {};
+            if (read(uhid.Get(), &req, sizeof(req)) <= 0)
+                break;
+            if (req.type != UHID_SET_REPORT)
+                continue;
+
+            received.assign(req.u.set_report.data, req.u.set_report.data + req.u.set_report.size);
+            uhid_event reply = {};
+            reply.type = UHID_SET_REPORT_REPLY;
+            reply.u.set_report_reply.id = req.u.set_report.id;
+            reply.u.set_report_reply.err = 0;
+            write(uhid.Get(), &reply, sizeof(reply));
+        }
+    });
+
+    HidRaw::Query query;
+    query.VendorID = vendorId;
+    query.ProductID = productId;
+    query.Usage = 0x0212;
+    query.UsagePage = 0xFF07;
+
+    // hidraw node is created asynchronously
+    std::vector<HidRaw::Match> matches;
+    for (int i = 0; (i < 50) && matches.empty(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        matches = HidRaw::FindDevices(query);
+    }
+
+    int res = -3;
+    if (matches.empty()) {
+        printf("ERROR: Virtual device not found.\n");
+    } else {
+        res = SetColor(query, 0x10, 0x20, 0x30);
+        TailLightReport expected;
+        expected.SetColor(0x302010);
+        if ((res == 0) && ((received.size() != sizeof(expected)) || memcmp(received.data(), &expected, sizeof(expected)))) {
+            printf("ERROR: Unexpected feature report received.\n");
+            res = -2;
+        }
+    }
+
+    done = true;
+    device.join();
+
+    ev = {};
+    ev.type = UHID_DESTROY;
+    write(uhid.Get(), &ev, sizeof(ev));
+
+    printf("%s\n", (res == 0) ? "SUCCESS: Self-test passed." : "ERROR: Self-test failed.");
+    return res;
+}
+
+
+int main(int argc, char* argv[]) {
+    HidRaw::Query query;
+    query.VendorID = 0x045E;  // Microsoft
+    query.ProductID = 0x082A; // Pro IntelliMouse
+    query.Usage = 0x0212;     //
+    query.UsagePage = 0xFF07; //
+
+    if ((argc >= 2) && (strcmp(argv[1], "bench") == 0)) {
+        BenchConfig config;
+        const char* jsonPath = nullptr;
+        for (int i = 2; i < argc; i++) {
+            if ((strcmp(argv[i], "--warmup") == 0) && (i + 1 < argc))
+                config.warmup = atoi(argv[++i]);
+            else if ((strcmp(argv[i], "--cpu") == 0) && (i + 1 < argc))
+                config.cpu = atoi(argv[++i]);
+            else if ((strcmp(argv[i], "--json") == 0) && (i + 1 < argc))
+                jsonPath = argv[++i];
+            else
+                config.iterations = atoi(argv[i]);
+        }
+        return Bench(query, config, jsonPath);
+    }
+    if ((argc >= 2) && (strcmp(argv[1], "list") == 0))
+        return List();
+    if ((argc >= 2) && (strcmp(argv[1], "selftest") == 0))
+        return SelfTest();
+    if ((argc >= 2) && (strcmp(argv[1], "parsebench") == 0))
+        return ParseBenchmark(argc - 2, argv + 2, 5.0);
+    if ((argc >= 3) && (strcmp(argv[1], "summary") == 0))
+        return SummarizeCapture(argv[2]);
+
+    if (argc < 4) {
+        printf("IntelliMouse tail-light shifter (Linux hidraw).\n");
+        printf("Usage: \"hidutil <red> <green> <blue>\" (example: \"hidutil 0 0 255\").\n");
+        printf("       \"hidutil bench [iterations] [--warmup N] [--cpu N] [--json file|-]\" to measure report request latency.\n");
+        printf("       \"hidutil list\" to list hidraw devices with their caps.\n");
+        printf("       \"hidutil parsebench <descriptor files>\" to measure report descriptor parse throughput.\n");
+        printf("       \"hidutil selftest\" to test against a virtual uhid device.\n");
+        printf("       \"hidutil summary <file>\" to summarize a HidUtil capture file.\n");
+        return -1;
+    }
+
+    return SetColor(query, (uint8_t)atoi(argv[1]), (uint8_t)atoi(argv[2]), (uint8_t)atoi(argv[3]));
+}
@@ -0,0 +1,474 @@
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#include <hidsdi.h>
+#endif
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+/** Report types in the same order as HIDP_REPORT_TYPE. */
+enum class ReportKind : uint8_t {
+    Input = 0,
+    Output = 1,
+    Feature = 2,
+};
+static constexpr unsigned int REPORT_KIND_COUNT = 3;
+
+
+/** Location of one report field (main item) within a report buffer.
+    Offsets are relative to a buffer that starts with the report ID byte, which is
+    also the case for devices without report IDs (ID 0), like for HidD_SetFeature. */
+struct ReportField {
+    ReportKind kind = ReportKind::Input;
+    uint8_t  reportId = 0;
+    uint16_t usagePage = 0;
+    uint16_t usage = 0;      // usage of first element (element i has usage+i if isRange)
+    uint16_t count = 1;      // number of elements
+    uint16_t bitSize = 0;    // element size in bits (max 32)
+    uint32_t bitOffset = 0;  // offset of first element in bits
+    int32_t  logicalMin = 0;
+    int32_t  logicalMax = 0;
+    bool     isRange = false;  // elements have consecutive usages
+    bool     isArray = false;  // elements contain usage indices (selector array)
+};
+
+
+/** Portable equivalent of HIDP_CAPS.
+    Field counts correspond to value caps and button caps (arrays and 1-bit fields). */
+struct ReportCaps {
+    uint16_t Usage = 0;     // of first top-level collection
+    uint16_t UsagePage = 0; // of first top-level collection
+    uint16_t InputReportByteLength = 0;
+    uint16_t OutputReportByteLength = 0;
+    uint16_t FeatureReportByteLength = 0;
+    uint16_t NumberInputButtonCaps = 0;
+    uint16_t NumberInputValueCaps = 0;
+    uint16_t NumberOutputButtonCaps = 0;
+    uint16_t NumberOutputValueCaps = 0;
+    uint16_t NumberFeatureButtonCaps = 0;
+    uint16_t NumberFeatureValueCaps = 0;
+};
+
+
+/** Descriptor-driven report encoder/decoder.
+    Report layouts are compiled once per device into a flat table of bit offsets and widths,
+    so that encoding and decoding become plain shift & mask operations on the report buffer.
+    The table can either be compiled from a raw report descriptor (portable) or from
+    Windows preparsed data. Assumes a little-endian host, like the HID wire format. */
+class ReportCodec {
+public:
+    /** Compile from raw report descriptor. Returns false if the descriptor is malformed. */
+    bool Parse(const uint8_t* desc, size_t length) {
+        m_fields.clear();
+        m_collections.clear();
+        for (unsigned int k = 0; k < REPORT_KIND_COUNT; k++)
+            m_length[k] = 0;
+
+        struct Globals {
+            uint16_t usagePage = 0;
+            int32_t  logicalMin = 0;
+            int32_t  logicalMax = 0;
+            uint32_t reportSize = 0;
+            uint32_t reportCount = 0;
+            uint8_t  reportId = 0;
+        };
+        Globals globals;
+        std::vector<Globals> stack; // for push/pop items
+
+        std::vector<uint32_t> usages;   // local usages (usage page in upper 16 bits, if specified)
+        uint32_t usageMin = 0, usageMax = 0;
+        bool hasRange = false;
+        unsigned int depth = 0; // collection nesting depth
+
+        std::vector<uint32_t> bitCount(REPORT_KIND_COUNT * 256, 0); // bits per report kind and ID
+
+        size_t pos = 0;
+        while (pos < length) {
+            uint8_t prefix = desc[pos++];
+            if (prefix == 0xFE) {
+                // long item (no defined usage): skip
+                if (pos + 2 > length)
+                    return false;
+                pos += 2 + desc[pos];
+                continue;
+            }
+
+            size_t size = prefix & 0x03;
+            if (size == 3)
+                size = 4;
+            if (pos + size > length)
+                return false;
+
+            uint32_t data = 0;
+            for (size_t i = 0; i < size; i++)
+                data |= (uint32_t)desc[pos + i] << (8 * i);
+            int32_t sdata = (int32_t)data; // sign-extended data
+            if ((size == 1) && (data & 0x80))
+                sdata = (int32_t)(data | 0xFFFFFF00);
+            else if ((size == 2) && (data & 0x8000))
+                sdata = (int32_t)(data | 0xFFFF0000);
+            pos += size;
+
+            uint8_t type = (prefix >> 2) & 0x03;
+            uint8_t tag = prefix >> 4;
+            if (type == 0) { // main item
+                int kind = -1;
+                if (tag == 0x8)
+                    kind = (int)ReportKind::Input;
+                else if (tag == 0x9)
+                    kind = (int)ReportKind::Output;
+                else if (tag == 0xB)
+                    kind = (int)ReportKind::Feature;
+
+                if (kind >= 0) {
+                    if (globals.reportSize > 32)
+                        return false; // unsupported element size
+
+                    uint32_t& bits = bitCount[kind * 256 + globals.reportId];
+                    bool constant = data & 0x01;
+                    bool variable = data & 0x02;
+                    if (!constant)
+                        AddFields((ReportKind)kind, globals.reportId, globals.usagePage, globals.logicalMin, globals.logicalMax, globals.reportSize, globals.reportCount,
+                            variable, usages, hasRange, usageMin, usageMax, 8 + bits);
+
+                    bits += globals.reportSize * globals.reportCount;
+                    uint16_t bytes = (uint16_t)(1 + (bits + 7) / 8); // including report ID byte
+                    if (bytes > m_length[kind])
+                        m_length[kind] = bytes;
+                } else if (tag == 0xA) { // collection
+                    if ((depth == 0) && (data == 0x01)) { // top-level application collection
+                        uint32_t usage = hasRange ? usageMin : (usages.empty() ? (uint32_t)globals.usagePage << 16 : usages[0]);
+                        m_collections.push_back(usage);
+                    }
+                    depth++;
+                } else if (tag == 0xC) { // end collection
+                    if (depth == 0)
+                        return false;
+                    depth--;
+                }
+
+                // main items reset local state
+                usages.clear();
+                hasRange = false;
+            } else if (type == 1) { // global item
+                switch (tag) {
+                case 0x0: globals.usagePage = (uint16_t)data; break;
+                case 0x1: globals.logicalMin = sdata; break;
+                case 0x2: globals.logicalMax = sdata; break;
+                case 0x7: globals.reportSize = data; break;
+                case 0x8: globals.reportId = (uint8_t)data; break;
+                case 0x9: globals.reportCount = data; break;
+                case 0xA: stack.push_back(globals); break;
+                case 0xB:
+                    if (stack.empty())
+                        return false;
+                    globals = stack.back();
+                    stack.pop_back();
+                    break;
+                }
+            } else if (type == 2) { // local item
+                uint32_t usage = (size == 4) ? data : (uint32_t)globals.usagePage << 16 | data;
+                switch (tag) {
+                case 0x0: usages.push_back(usage); break;
+                case 0x1: usageMin = usage; hasRange = true; break;
+                case 0x2: usageMax = usage; hasRange = true; break;
+                }
+            }
+        }
+
+        return depth == 0;
+    }
+
+#ifdef _WIN32
+    /** Compile from Windows preparsed data.
+        hid.dll doesn't expose bit offsets, so they are determined by setting each
+        usage to all-ones in an otherwise zeroed report and locating the changed bits. */
+    bool Compile(PHIDP_PREPARSED_DATA reportDesc, const HIDP_CAPS& caps) {
+        m_fields.clear();
+        m_collections.assign(1, (uint32_t)caps.UsagePage << 16 | caps.Usage);
+        m_length[(int)ReportKind::Input] = caps.InputReportByteLength;
+        m_length[(int)ReportKind::Output] = caps.OutputReportByteLength;
+        m_length[(int)ReportKind::Feature] = caps.FeatureReportByteLength;
+
+        const USHORT valueCapsCount[] = {caps.NumberInputValueCaps, caps.NumberOutputValueCaps, caps.NumberFeatureValueCaps};
+        const USHORT buttonCapsCount[] = {caps.NumberInputButtonCaps, caps.NumberOutputButtonCaps, caps.NumberFeatureButtonCaps};
+
+        for (unsigned int k = 0; k < REPORT_KIND_COUNT; k++) {
+            auto type = (HIDP_REPORT_TYPE)k;
+            std::vector<uint8_t> report(m_length[k], 0);
+
+            std::vector<HIDP_VALUE_CAPS> valueCaps(valueCapsCount[k]);
+            USHORT valueCapsLength = valueCapsCount[k];
+            if (valueCapsLength && (HidP_GetValueCaps(type, valueCaps.data(), &valueCapsLength, reportDesc) != HIDP_STATUS_SUCCESS))
+                return false;
+
+            for (USHORT i = 0; i < valueCapsLength; i++) {
+                const HIDP_VALUE_CAPS& vc = valueCaps[i];
+                if (vc.IsAlias || (vc.BitSize == 0) || (vc.BitSize > 32))
+                    continue; // field already covered or not supported
+
+                ReportField field;
+                field.kind = (ReportKind)k;
+                field.reportId = vc.ReportID;
+                field.usagePage = vc.UsagePage;
+                field.usage = vc.IsRange ? vc.Range.UsageMin : vc.NotRange.Usage;
+                field.count = vc.IsRange ? (uint16_t)(vc.Range.UsageMax - vc.Range.UsageMin + 1) : vc.ReportCount;
+                field.bitSize = vc.BitSize;
+                field.logicalMin = vc.LogicalMin;
+                field.logicalMax = vc.LogicalMax;
+                field.isRange = vc.IsRange;
+
+                std::fill(report.begin(), report.end(), (uint8_t)0);
+                report[0] = vc.ReportID;
+                NTSTATUS status = 0;
+                if (!vc.IsRange && (vc.ReportCount > 1)) {
+                    std::vector<char> ones((vc.ReportCount * vc.BitSize + 7) / 8, (char)0xFF);
+                    status = HidP_SetUsageValueArray(type, vc.UsagePage, vc.LinkCollection, field.usage, ones.data(), (USHORT)ones.size(), reportDesc, (PCHAR)report.data(), (ULONG)report.size());
+                } else {
+                    ULONG ones = (vc.BitSize == 32) ? 0xFFFFFFFF : (1ul << vc.BitSize) - 1;
+                    status = HidP_SetUsageValue(type, vc.UsagePage, vc.LinkCollection, field.usage, ones, reportDesc, (PCHAR)report.data(), (ULONG)report.size());
+                }
+                if ((status != HIDP_STATUS_SUCCESS) || !FirstSetBit(report, field.bitOffset))
+                    continue;
+
+                m_fields.push_back(field);
+            }
+
+            std::vector<HIDP_BUTTON_CAPS> buttonCaps(buttonCapsCount[k]);
+            USHORT buttonCapsLength = buttonCapsCount[k];
+            if (buttonCapsLength && (HidP_GetButtonCaps(type, buttonCaps.data(), &buttonCapsLength, reportDesc) != HIDP_STATUS_SUCCESS))
+                return false;
+
+            for (USHORT i = 0; i < buttonCapsLength; i++) {
+                const HIDP_BUTTON_CAPS& bc = buttonCaps[i];
+                if (bc.IsAlias)
+                    continue;
+
+                ReportField field;
+                field.kind = (ReportKind)k;
+                field.reportId = bc.ReportID;
+                field.usagePage = bc.UsagePage;
+                field.usage = bc.IsRange ? bc.Range.UsageMin : bc.NotRange.Usage;
+                field.count = bc.IsRange ? (uint16_t)(bc.Range.UsageMax - bc.Range.UsageMin + 1) : 1;
+                field.bitSize = 1;
+                field.logicalMin = 0;
+                field.logicalMax = 1;
+                field.isRange = bc.IsRange;
+
+                std::fill(report.begin(), report.end(), (uint8_t)0);
+                report[0] = bc.ReportID;
+                USAGE usage = field.usage;
+                ULONG usageLength = 1;
+                if (HidP_SetUsages(type, bc.UsagePage, bc.LinkCollection, &usage, &usageLength, reportDesc, (PCHAR)report.data(), (ULONG)report.size()) != HIDP_STATUS_SUCCESS)
+                    continue;
+
+                // selector arrays store the usage index instead of a single bit (not supported)
+                if (!FirstSetBit(report, field.bitOffset) || (PopCount(report) != 1))
+                    continue;
+
+                m_fields.push_back(field);
+            }
+        }
+
+        return true;
+    }
+#endif
+
+    const std::vector<ReportField>& Fields() const {
+        return m_fields;
+    }
+
+    /** Top-level collection usages (usage page in upper 16 bits). */
+    const std::vector<uint32_t>& Collections() const {
+        return m_collections;
+    }
+
+    /** Returns true if any top-level collection matches. Zero usage or usage page matches any value. */
+    bool HasCollection(uint16_t usagePage, uint16_t usage) const {
+        for (uint32_t c : m_collections) {
+            if ((!usagePage || (usagePage == (c >> 16))) && (!usage || (usage == (uint16_t)c)))
+                return true;
+        }
+        return false;
+    }
+
+    /** Capabilities summary. Report lengths cover all top-level collections. */
+    ReportCaps Caps() const {
+        ReportCaps caps;
+        if (!m_collections.empty()) {
+            caps.UsagePage = (uint16_t)(m_collections[0] >> 16);
+            caps.Usage = (uint16_t)m_collections[0];
+        }
+        caps.InputReportByteLength = m_length[(int)ReportKind::Input];
+        caps.OutputReportByteLength = m_length[(int)ReportKind::Output];
+        caps.FeatureReportByteLength = m_length[(int)ReportKind::Feature];
+
+        uint16_t* buttonCaps[] = {&caps.NumberInputButtonCaps, &caps.NumberOutputButtonCaps, &caps.NumberFeatureButtonCaps};
+        uint16_t* valueCaps[] = {&caps.NumberInputValueCaps, &caps.NumberOutputValueCaps, &caps.NumberFeatureValueCaps};
+        for (const ReportField& f : m_fields) {
+            if (f.isArray || (f.bitSize == 1))
+                (*buttonCaps[(int)f.kind])++;
+            else
+                (*valueCaps[(int)f.kind])++;
+        }
+        return caps;
+    }
+
+    /** Report buffer length in bytes, including the report ID byte. */
+    uint16_t ReportLength(ReportKind kind) const {
+        return m_length[(int)kind];
+    }
+
+    /** Find the field containing a usage. Sets "index" to the element index. Returns nullptr if not found. */
+    const ReportField* Find(ReportKind kind, uint8_t reportId, uint16_t usagePage, uint16_t usage, unsigned int* index = nullptr) const {
+        for (const ReportField& f : m_fields) {
+            if ((f.kind != kind) || (f.reportId != reportId) || (f.usagePage != usagePage) || f.isArray)
+                continue;
+
+            unsigned int idx = 0;
+            if (f.isRange) {
+                if ((usage < f.usage) || (usage >= f.usage + f.count))
+                    continue;
+                idx = usage - f.usage;
+            } else if (usage != f.usage) {
+                continue;
+            }
+
+            if (index)
+                *index = idx;
+            return &f;
+        }
+        return nullptr;
+    }
+
+    /** Find the field with an element at a given bit offset. Sets "index" to the element index. Returns nullptr if not found. */
+    const ReportField* FindAt(ReportKind kind, uint8_t reportId, uint32_t bitOffset, unsigned int* index = nullptr) const {
+        for (const ReportField& f : m_fields) {
+            if ((f.kind != kind) || (f.reportId != reportId) || (bitOffset < f.bitOffset))
+                continue;
+
+            uint32_t rel = bitOffset - f.bitOffset;
+            if ((rel % f.bitSize != 0) || (rel / f.bitSize >= f.count))
+                continue;
+
+            if (index)
+                *index = rel / f.bitSize;
+            return &f;
+        }
+        return nullptr;
+    }
+
+    /** Store raw element value. Bits outside the element are preserved. */
+    static void Encode(const ReportField& f, unsigned int index, uint32_t value, uint8_t* report) {
+        uint32_t bit = f.bitOffset + index * f.bitSize;
+        uint8_t* ptr = report + bit / 8;
+        unsigned int shift = bit % 8;
+        if ((shift == 0) && (f.bitSize == 8)) {
+            *ptr = (uint8_t)value; // common case
+            return;
+        }
+
+        size_t bytes = (shift + f.bitSize + 7) / 8;
+        uint64_t word = 0;
+        memcpy(&word, ptr, bytes);
+        uint64_t mask = Mask(f.bitSize) << shift;
+        word = (word & ~mask) | (((uint64_t)value << shift) & mask);
+        memcpy(ptr, &word, bytes);
+    }
+
+    /** Load raw element value. */
+    static uint32_t Decode(const ReportField& f, unsigned int index, const uint8_t* report) {
+        uint32_t bit = f.bitOffset + index * f.bitSize;
+        const uint8_t* ptr = report + bit / 8;
+        unsigned int shift = bit % 8;
+        if ((shift == 0) && (f.bitSize == 8))
+            return *ptr; // common case
+
+        size_t bytes = (shift + f.bitSize + 7) / 8;
+        uint64_t word = 0;
+        memcpy(&word, ptr, bytes);
+        return (uint32_t)((word >> shift) & Mask(f.bitSize));
+    }
+
+    /** Load element value, sign-extended if the logical range is signed. */
+    static int32_t DecodeSigned(const ReportField& f, unsigned int index, const uint8_t* report) {
+        uint32_t value = Decode(f, index, report);
+        if ((f.logicalMin < 0) && (f.bitSize < 32) && (value & (1u << (f.bitSize - 1))))
+            value |= ~(uint32_t)Mask(f.bitSize);
+        return (int32_t)value;
+    }
+
+private:
+    static uint64_t Mask(unsigned int bitSize) {
+        return (1ull << bitSize) - 1;
+    }
+
+    /** Add fields for a non-constant main item. */
+    void AddFields(ReportKind kind, uint8_t reportId, uint16_t usagePage, int32_t logicalMin, int32_t logicalMax, uint32_t reportSize, uint32_t reportCount,
+            bool variable, const std::vector<uint32_t>& usages, bool hasRange, uint32_t usageMin, uint32_t usageMax, uint32_t bitOffset) {
+        if ((reportSize == 0) || (reportCount == 0))
+            return;
+
+        ReportField field;
+        field.kind = kind;
+        field.reportId = reportId;
+        field.bitSize = (uint16_t)reportSize;
+        field.logicalMin = logicalMin;
+        field.logicalMax = logicalMax;
+        field.bitOffset = bitOffset;
+
+        if (!variable || hasRange || usages.empty()) {
+            // single field covering all elements
+            uint32_t first = hasRange ? usageMin : (usages.empty() ? (uint32_t)usagePage << 16 : usages[0]);
+            field.usagePage = (uint16_t)(first >> 16);
+            field.usage = (uint16_t)first;
+            field.count = (uint16_t)reportCount;
+            field.isRange = variable && hasRange;
+            field.isArray = !variable;
+            if (field.isRange && (usageMax >= usageMin) && (usageMax - usageMin + 1 < reportCount))
+                field.count = (uint16_t)(usageMax - usageMin + 1); // excess elements are padding
+            m_fields.push_back(field);
+            return;
+        }
+
+        // one field per listed usage, where the last usage covers the remaining elements
+        for (size_t i = 0; (i < usages.size()) && (i < reportCount); i++) {
+            field.usagePage = (uint16_t)(usages[i] >> 16);
+            field.usage = (uint16_t)usages[i];
+            field.count = (i + 1 == usages.size()) ? (uint16_t)(reportCount - i) : 1;
+            field.bitOffset = bitOffset + (uint32_t)i * reportSize;
+            m_fields.push_back(field);
+        }
+    }
+
+    /** Find the first set bit after the report ID byte. */
+    static bool FirstSetBit(const std::vector<uint8_t>& report, uint32_t& bit) {
+        for (size_t i = 1; i < report.size(); i++) {
+            if (!report[i])
+                continue;
+
+            unsigned int b = 0;
+            while (!(report[i] & (1u << b)))
+                b++;
+            bit = (uint32_t)(8 * i + b);
+            return true;
+        }
+        return false;
+    }
+
+    static unsigned int PopCount(const std::vector<uint8_t>& report) {
+        unsigned int count = 0;
+        for (size_t i = 1; i < report.size(); i++) {
+            for (uint8_t v = report[i]; v; v &= v - 1)
+                count++;
+        }
+        return count;
+    }
+
+    std::vector<ReportField> m_fields;
+    std::vector<uint32_t>    m_collections; // top-level collection usages
+    uint16_t                 m_length[REPORT_KIND_COUNT] = {};
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+/** Lock-free single-producer single-consumer ring buffer.
+    Capacity is rounded up to a power of two. One thread may call TryPush while another calls TryPop. */
+template <class T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    /** Returns false if the buffer is full. */
+    bool TryPush(const T& item) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+            return false; // full
+
+        m_slots[head & m_mask] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Returns false if the buffer is empty. */
+    bool TryPop(T& item) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+            return false; // empty
+
+        item = m_slots[tail & m_mask];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t Capacity() const {
+        return m_mask + 1;
+    }
+
+private:
+    std::vector<T> m_slots;
+    size_t         m_mask = 0;
+    // producer and consumer indices on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<size_t> m_head = 0; // next slot to write
+    alignas(64) std::atomic<size_t> m_tail = 0; // next slot to read
+};
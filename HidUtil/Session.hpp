@@ -0,0 +1,88 @@
+#pragma once
+#include "HID.hpp"
+#include "SessionState.hpp"
+#include <cwctype>
+
+#pragma comment(lib, "cfgmgr32.lib") // for CM_Register_Notification
+
+
+/** Long-lived set of open devices matching a query.
+    Devices are enumerated once and then kept up to date through device-interface
+    arrival/removal notifications, so that clients can access them without re-enumeration. */
+class HID::Session {
+public:
+    Session(const Query& query, DeviceCache* cache = nullptr) : m_query(query), m_state([this](const std::wstring& path) { return Open(path); }) {
+        // register for notifications before enumerating to not miss any arrivals in-between
+        CM_NOTIFY_FILTER filter = {};
+        filter.cbSize = sizeof(filter);
+        filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+        filter.u.DeviceInterface.ClassGuid = GUID_DEVINTERFACE_HID;
+        CONFIGRET cr = CM_Register_Notification(&filter, this, OnNotification, &m_notify);
+        if (cr != CR_SUCCESS)
+            wprintf(L"WARNING: CM_Register_Notification failed (cr %u). Hot-plug disabled.\n", cr);
+
+        for (Match& match : FindDevices(m_query, cache)) {
+            std::wstring path = Normalize(match.name.c_str());
+            m_state.Add(path, std::move(match));
+        }
+    }
+
+    ~Session() {
+        if (m_notify)
+            CM_Unregister_Notification(m_notify); // waits for pending callbacks
+    }
+
+    Session(const Session&) = delete;
+    Session& operator = (const Session&) = delete;
+
+    /** Invoke fn(match) for each open device. Hot-plug changes are blocked during the call. */
+    template <class Fn>
+    void ForEach(Fn fn) {
+        m_state.ForEach([&fn](const std::wstring& /*path*/, Match& match) {
+            fn(match);
+        });
+    }
+
+    size_t Count() const {
+        return m_state.Count();
+    }
+
+    /** Incremented on every device arrival or removal. */
+    unsigned int Generation() const {
+        return m_state.Generation();
+    }
+
+private:
+    std::optional<Match> Open(const std::wstring& path) const {
+        DeviceCache::Entry attr;
+        bool attrValid = false;
+        Match match = CheckDevice(path.c_str(), m_query, attr, attrValid);
+        if (match.name.empty())
+            return std::nullopt;
+        return match;
+    }
+
+    /** Symbolic link casing differs between enumeration and notifications. */
+    static std::wstring Normalize(const wchar_t* path) {
+        std::wstring result(path);
+        for (wchar_t& c : result)
+            c = (wchar_t)towlower(c);
+        return result;
+    }
+
+    static DWORD CALLBACK OnNotification(HCMNOTIFICATION /*notify*/, void* context, CM_NOTIFY_ACTION action, CM_NOTIFY_EVENT_DATA* eventData, DWORD /*eventDataSize*/) {
+        auto* self = static_cast<Session*>(context);
+        if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL) {
+            if (self->m_state.OnArrival(Normalize(eventData->u.DeviceInterface.SymbolicLink)))
+                wprintf(L"Device arrived: %s\n", eventData->u.DeviceInterface.SymbolicLink);
+        } else if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL) {
+            if (self->m_state.OnRemoval(Normalize(eventData->u.DeviceInterface.SymbolicLink)))
+                wprintf(L"Device removed: %s\n", eventData->u.DeviceInterface.SymbolicLink);
+        }
+        return ERROR_SUCCESS;
+    }
+
+    Query               m_query;
+    SessionState<Match> m_state;
+    HCMNOTIFICATION     m_notify = nullptr;
+};
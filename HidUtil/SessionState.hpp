@@ -0,0 +1,85 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+
+
+/** Platform-independent device tracking for HID::Session.
+    Tracks interface paths through arrival, matching and removal, and owns the opened devices.
+    "Device" is the platform-specific type for an opened and matched device.
+    All methods are thread-safe, since arrival/removal notifications come from a separate thread. */
+template <class Device>
+class SessionState {
+public:
+    /** Open and check a device interface. Returns std::nullopt if the device doesn't match. */
+    using OpenFn = std::function<std::optional<Device>(const std::wstring& path)>;
+
+    explicit SessionState(OpenFn open) : m_open(std::move(open)) {
+    }
+
+    /** Add an already opened and matched device. */
+    void Add(const std::wstring& path, Device&& dev) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_rejected.erase(path);
+        m_devices.erase(path);
+        m_devices.emplace(path, std::move(dev));
+        m_generation++;
+    }
+
+    /** Handle interface arrival. Returns true if the device matched and was opened. */
+    bool OnArrival(const std::wstring& path) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_devices.count(path) || m_rejected.count(path))
+            return false; // duplicate notification
+
+        std::optional<Device> dev = m_open(path);
+        if (!dev) {
+            m_rejected.insert(path); // don't reopen on duplicate notifications
+            return false;
+        }
+
+        m_devices.emplace(path, std::move(*dev));
+        m_generation++;
+        return true;
+    }
+
+    /** Handle interface removal. Returns true if a matched device was closed. */
+    bool OnRemoval(const std::wstring& path) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_rejected.erase(path); // path might be reused by another device
+        if (!m_devices.erase(path))
+            return false;
+
+        m_generation++;
+        return true;
+    }
+
+    /** Invoke fn(path, device) for each matched device. Arrival/removal is blocked during the call. */
+    template <class Fn>
+    void ForEach(Fn fn) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& [path, dev] : m_devices)
+            fn(path, dev);
+    }
+
+    size_t Count() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_devices.size();
+    }
+
+    /** Incremented on every change to the set of matched devices. */
+    unsigned int Generation() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_generation;
+    }
+
+private:
+    OpenFn                         m_open;
+    mutable std::mutex             m_mutex;
+    std::map<std::wstring, Device> m_devices;  // matched devices
+    std::set<std::wstring>         m_rejected; // checked devices that didn't match
+    unsigned int                   m_generation = 0;
+};
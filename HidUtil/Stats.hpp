@@ -0,0 +1,175 @@
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+/** Latency sample collection with summary statistics. Samples are in microseconds. */
+class LatencyStats {
+public:
+    void Add(double sample) {
+        m_samples.push_back(sample);
+        m_sorted = false;
+    }
+
+    size_t Count() const {
+        return m_samples.size();
+    }
+
+    double Min() {
+        Sort();
+        return m_samples.empty() ? 0 : m_samples.front();
+    }
+
+    double Max() {
+        Sort();
+        return m_samples.empty() ? 0 : m_samples.back();
+    }
+
+    double Mean() const {
+        double sum = 0;
+        for (double s : m_samples)
+            sum += s;
+        return m_samples.empty() ? 0 : sum / m_samples.size();
+    }
+
+    /** Sample standard deviation. */
+    double StdDev() const {
+        if (m_samples.size() < 2)
+            return 0;
+        double mean = Mean();
+        double sum = 0;
+        for (double s : m_samples)
+            sum += (s - mean) * (s - mean);
+        return std::sqrt(sum / (m_samples.size() - 1));
+    }
+
+    /** Percentile (0-100) with linear interpolation between closest ranks. */
+    double Percentile(double p) {
+        Sort();
+        if (m_samples.empty())
+            return 0;
+
+        double rank = p / 100 * (m_samples.size() - 1);
+        size_t lo = (size_t)rank;
+        size_t hi = (std::min)(lo + 1, m_samples.size() - 1);
+        return m_samples[lo] + (rank - lo) * (m_samples[hi] - m_samples[lo]);
+    }
+
+private:
+    void Sort() {
+        if (!m_sorted)
+            std::sort(m_samples.begin(), m_samples.end());
+        m_sorted = true;
+    }
+
+    std::vector<double> m_samples;
+    bool                m_sorted = true;
+};
+
+
+/** Run "fn" for warm-up and then measure each of "iterations" calls.
+    "fn" returns false on failure. Failed calls are counted but not sampled. */
+template <class Fn>
+LatencyStats Measure(unsigned int warmup, unsigned int iterations, size_t& failures, Fn fn) {
+    using clock = std::chrono::steady_clock;
+
+    for (unsigned int i = 0; i < warmup; i++)
+        fn();
+
+    LatencyStats stats;
+    failures = 0;
+    for (unsigned int i = 0; i < iterations; i++) {
+        auto t0 = clock::now();
+        bool ok = fn();
+        auto t1 = clock::now();
+        if (ok)
+            stats.Add(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        else
+            failures++;
+    }
+    return stats;
+}
+
+
+/** Pin the calling thread to a CPU and raise its priority to reduce scheduling noise. */
+inline bool PinCurrentThread(unsigned int cpu) {
+#ifdef _WIN32
+    if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu))
+        return false;
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST); // ignore errors
+    return true;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+}
+
+
+/** Benchmark results for one operation on one device. */
+struct BenchResult {
+    std::string  device;
+    std::string  operation;
+    LatencyStats stats;
+    size_t       failures = 0;
+};
+
+/** Benchmark settings, included in the report for reproducibility. */
+struct BenchConfig {
+    unsigned int warmup = 100;
+    unsigned int iterations = 1000;
+    int          cpu = -1; // pinned CPU (-1 if not pinned)
+};
+
+
+/** Percentiles included in reports. */
+static constexpr double BENCH_PERCENTILES[] = {50, 90, 99, 99.9};
+
+
+/** Print human-readable result table. */
+inline void PrintBenchReport(FILE* out, std::vector<BenchResult>& results) {
+    fprintf(out, "%-16s %8s %8s %9s %9s %9s %9s %9s %9s  %s\n", "operation", "samples", "failed", "min", "mean", "p50", "p90", "p99", "max", "device");
+    for (BenchResult& r : results) {
+        fprintf(out, "%-16s %8zu %8zu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f  %s\n", r.operation.c_str(), r.stats.Count(), r.failures,
+            r.stats.Min(), r.stats.Mean(), r.stats.Percentile(50), r.stats.Percentile(90), r.stats.Percentile(99), r.stats.Max(), r.device.c_str());
+    }
+    fprintf(out, "(latencies in microseconds)\n");
+}
+
+
+/** Write machine-readable JSON report. Latencies are in microseconds. */
+inline void WriteBenchJson(FILE* out, const BenchConfig& config, std::vector<BenchResult>& results) {
+    auto escape = [](const std::string& str) {
+        std::string result;
+        for (char c : str) {
+            if ((c == '"') || (c == '\\'))
+                result += '\\';
+            if ((unsigned char)c < 0x20)
+                continue; // control characters are not expected in device names
+            result += c;
+        }
+        return result;
+    };
+
+    fprintf(out, "{\n  \"warmup\": %u,\n  \"iterations\": %u,\n  \"cpu\": %d,\n  \"results\": [\n", config.warmup, config.iterations, config.cpu);
+    for (size_t i = 0; i < results.size(); i++) {
+        BenchResult& r = results[i];
+        fprintf(out, "    {\"device\": \"%s\", \"operation\": \"%s\", \"samples\": %zu, \"failures\": %zu, ", escape(r.device).c_str(), escape(r.operation).c_str(), r.stats.Count(), r.failures);
+        fprintf(out, "\"min\": %.3f, \"mean\": %.3f, \"stddev\": %.3f, \"max\": %.3f, \"percentiles\": {", r.stats.Min(), r.stats.Mean(), r.stats.StdDev(), r.stats.Max());
+        for (size_t p = 0; p < std::size(BENCH_PERCENTILES); p++)
+            fprintf(out, "%s\"p%g\": %.3f", p ? ", " : "", BENCH_PERCENTILES[p], r.stats.Percentile(BENCH_PERCENTILES[p]));
+        fprintf(out, "}}%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
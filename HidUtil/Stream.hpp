@@ -0,0 +1,127 @@
+#pragma once
+#include "HID.hpp"
+#include "TailLight.hpp"
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+
+/** High-resolution waitable timer for pacing frames. */
+class FrameTimer {
+public:
+    FrameTimer() {
+        m_timer.Attach(CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+        if (!m_timer.IsValid())
+            m_timer.Attach(CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS)); // pre-Win10 1803 fallback
+    }
+
+    /** Block until the deadline. Returns immediately if the deadline has passed. */
+    void WaitUntil(std::chrono::steady_clock::time_point deadline) {
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= remaining.zero())
+            return;
+
+        LARGE_INTEGER dueTime = {};
+        dueTime.QuadPart = -(LONGLONG)std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100; // relative time in 100ns units
+        if (SetWaitableTimer(m_timer.Get(), &dueTime, 0, NULL, NULL, FALSE))
+            WaitForSingleObject(m_timer.Get(), INFINITE);
+    }
+
+private:
+    Microsoft::WRL::Wrappers::Event m_timer; // generic HANDLE RAII wrapper
+};
+
+
+/** Stream colors to all matched devices.
+    Each input line contains "<red> <green> <blue> <delay_ms>", where delay is the time until the next frame.
+    Frames are paced against absolute deadlines. Frames whose display time is already over when due are dropped,
+    except for zero-delay frames and the last frame, so that the final color is always applied.
+    Sent reports are recorded to "capture" if specified.
+    If "verifyInterval" is non-zero, the color is read back once per "verifyInterval" frames. */
+int StreamColors(const HID::Query& query, FILE* input, CaptureWriter* capture = nullptr, unsigned int verifyInterval = 0) {
+    using clock = std::chrono::steady_clock;
+    using ms = std::chrono::duration<double, std::milli>;
+
+    auto matches = HID::FindDevices(query);
+    std::vector<TailLightWriter> writers;
+    for (HID::Match& match : matches) {
+        TailLightWriter writer(match.dev.Get(), match.report, match.caps);
+        if (!writer.IsValid())
+            continue;
+        if (capture)
+            writer.SetCapture(capture, capture->AddDevice(match.name));
+        writer.SetVerify(verifyInterval);
+        writers.push_back(writer);
+    }
+    if (writers.empty()) {
+        wprintf(L"No matching devices found.\n");
+        return -3;
+    }
+
+    FrameTimer timer;
+    size_t frames = 0;
+    size_t dropped = 0;
+    size_t failures = 0;
+    double driftSum = 0;  // in ms
+    size_t driftFrames = 0; // frames included in driftSum
+    double driftMax = 0;  // in ms
+
+    // apply frame to all devices in parallel
+    auto writeFrame = [&writers, &failures, &frames](COLORREF color) {
+        std::atomic<size_t> frameFailures = 0;
+        std::for_each(std::execution::par, writers.begin(), writers.end(), [color, &frameFailures](TailLightWriter& writer) {
+            if (!writer.Set(color))
+                frameFailures++;
+        });
+        failures += frameFailures;
+        frames++;
+    };
+
+    clock::time_point deadline = clock::now();
+    unsigned int red = 0, green = 0, blue = 0;
+    double delay = 0; // in ms
+    std::optional<COLORREF> skipped; // last frame, if it was dropped
+    while (fscanf_s(input, "%u %u %u %lf", &red, &green, &blue, &delay) == 4) {
+        COLORREF color = RGB(red, green, blue);
+        clock::time_point next = deadline + std::chrono::duration_cast<clock::duration>(ms(delay));
+        if ((delay > 0) && (clock::now() >= next)) {
+            // frame is already over (but still sent below if it turns out to be the last)
+            dropped++;
+            skipped = color;
+            deadline = next;
+            continue;
+        }
+        skipped.reset();
+
+        timer.WaitUntil(deadline);
+        double drift = ms(clock::now() - deadline).count();
+        driftSum += drift;
+        driftFrames++;
+        if (drift > driftMax)
+            driftMax = drift;
+
+        writeFrame(color);
+        deadline = next;
+    }
+
+    if (skipped) {
+        // always end with the final color (excluded from drift, since its deadline has passed)
+        dropped--;
+        writeFrame(*skipped);
+    }
+
+    unsigned int mismatches = 0;
+    unsigned int readFailures = 0;
+    for (TailLightWriter& writer : writers) {
+        writer.Verify(); // remaining frames
+        mismatches += writer.Mismatches();
+        readFailures += writer.ReadFailures();
+    }
+
+    wprintf(L"Streamed %zu frames to %zu device(s). Dropped %zu frames. %zu write failures.\n", frames, writers.size(), dropped, failures);
+    if (verifyInterval)
+        wprintf(L"Verified every %u frames: %u color mismatches, %u readback failures.\n", verifyInterval, mismatches, readFailures);
+    if (driftFrames)
+        wprintf(L"Drift: mean %.3f ms, max %.3f ms\n", driftSum/driftFrames, driftMax);
+    return failures ? -2 : 0;
+}
@@ -1,68 +1,183 @@
 #pragma once
 #include <Windows.h>
 #include <Hidsdi.h>
-#include "../TailLight/TailLight.h"
-
-
-bool GetTailLight(HANDLE hid_dev, COLORREF & color) {
-    std::vector<BYTE> featureReport(41, 0); // 41 observed in WireShark
-    featureReport[0] = 0x27; // 39 observed in WireShark (with type 1=Input report)
-    featureReport[1] = 1; // observed in WireShark
-    featureReport[2] = 1; // observed in WireShark
-    featureReport[3] = 0; // observed in WireShark
-    featureReport[4] = 0x29; // observed in WireShark
-    featureReport[5] = 0; // observed in WireShark
-    BOOLEAN ok = HidD_GetFeature(hid_dev, featureReport.data(), (ULONG)featureReport.size());
-    if (!ok) {
-        DWORD err = GetLastError();
-        printf("ERROR: HidD_GetFeature failure (err %d).\n", err);
-        assert(ok);
-        return false;
+#include "CaptureFile.hpp"
+#include "TailLightLayout.hpp"
+
+
+/** Tail-light writer that compiles the feature report layout once and then issues bare HidD_SetFeature calls. */
+class TailLightWriter {
+public:
+    TailLightWriter(HANDLE hid_dev, PHIDP_PREPARSED_DATA reportDesc, HIDP_CAPS caps) : m_dev(hid_dev), m_inputReportLength(caps.InputReportByteLength) {
+#if 0
+        printf("Device capabilities:\n");
+        printf("  Usage=0x%04X, UsagePage=0x%04X\n", caps.Usage, caps.UsagePage);
+        printf("  InputReportByteLength=%u, OutputReportByteLength=%u, FeatureReportByteLength=%u, NumberLinkCollectionNodes=%u\n", caps.InputReportByteLength, caps.OutputReportByteLength, caps.FeatureReportByteLength, caps.NumberLinkCollectionNodes);
+        printf("  NumberInputButtonCaps=%u, NumberInputValueCaps=%u, NumberInputDataIndices=%u\n", caps.NumberInputButtonCaps, caps.NumberInputValueCaps, caps.NumberInputDataIndices);
+        printf("  NumberOutputButtonCaps=%u, NumberOutputValueCaps=%u, NumberOutputDataIndices=%u\n", caps.NumberOutputButtonCaps, caps.NumberOutputValueCaps, caps.NumberOutputDataIndices);
+        printf("  NumberFeatureButtonCaps=%u, NumberFeatureValueCaps=%u, NumberFeatureDataIndices=%u\n", caps.NumberFeatureButtonCaps, caps.NumberFeatureValueCaps, caps.NumberFeatureDataIndices);
+#endif
+
+        if (caps.FeatureReportByteLength != sizeof(TailLightReport))
+            return; // length mismatch
+
+        ReportCodec codec;
+        if (codec.Compile(reportDesc, caps))
+            m_valid = m_layout.Init(codec);
+        else
+            m_valid = m_layout.InitFixed(); // length matches, but fields couldn't be compiled
     }
 
-    color = 0;
-    return true;
+    /** Returns true if the device supports tail-light reports. */
+    bool IsValid() const {
+        return m_valid;
+    }
 
-}
+    /** Record all reports sent and received to a capture file. */
+    void SetCapture(CaptureWriter* capture, uint16_t device) {
+        m_capture = capture;
+        m_captureDevice = device;
+    }
 
+    bool Set(COLORREF color) {
+        m_layout.SetColor(GetRValue(color), GetGValue(color), GetBValue(color));
 
-bool UpdateTailLight(HANDLE hid_dev, PHIDP_PREPARSED_DATA reportDesc, HIDP_CAPS caps, COLORREF color) {
-#if 0
-    printf("Device capabilities:\n");
-    printf("  Usage=0x%04X, UsagePage=0x%04X\n", caps.Usage, caps.UsagePage);
-    printf("  InputReportByteLength=%u, OutputReportByteLength=%u, FeatureReportByteLength=%u, NumberLinkCollectionNodes=%u\n", caps.InputReportByteLength, caps.OutputReportByteLength, caps.FeatureReportByteLength, caps.NumberLinkCollectionNodes);
-    printf("  NumberInputButtonCaps=%u, NumberInputValueCaps=%u, NumberInputDataIndices=%u\n", caps.NumberInputButtonCaps, caps.NumberInputValueCaps, caps.NumberInputDataIndices);
-    printf("  NumberOutputButtonCaps=%u, NumberOutputValueCaps=%u, NumberOutputDataIndices=%u\n", caps.NumberOutputButtonCaps, caps.NumberOutputValueCaps, caps.NumberOutputDataIndices);
-    printf("  NumberFeatureButtonCaps=%u, NumberFeatureValueCaps=%u, NumberFeatureDataIndices=%u\n", caps.NumberFeatureButtonCaps, caps.NumberFeatureValueCaps, caps.NumberFeatureDataIndices);
-#endif
+        const std::vector<uint8_t>& report = m_layout.Report();
+        BOOLEAN ok = HidD_SetFeature(m_dev, (PVOID)report.data(), (ULONG)report.size());
+        if (m_capture)
+            m_capture->Write(m_captureDevice, HidP_Feature, (uint8_t)(CAPTURE_SENT | (ok ? 0 : CAPTURE_FAILED)), report.data(), (uint16_t)report.size());
+        if (!ok) {
+            DWORD err = GetLastError();
+            printf("ERROR: HidD_SetFeature failure (err %d).\n", err);
+            return false;
+        }
 
-    if (caps.FeatureReportByteLength != 73)
-        return false; // length mismatch
+        m_lastColor = color;
+        if (m_verifyInterval && (++m_unverified >= m_verifyInterval))
+            Verify(); // mismatches are counted
+        return true;
+    }
 
-    HIDP_VALUE_CAPS     valueCaps = {};
-    USHORT              ValueCapsLength = caps.NumberFeatureValueCaps;
-    NTSTATUS status = HidP_GetValueCaps(HidP_Feature, &valueCaps, &ValueCapsLength, reportDesc);
-    assert(status == HIDP_STATUS_SUCCESS);
+    /** Read back the current color through feature report 0x27 (39). */
+    bool Get(COLORREF& color) const {
+        if (!m_valid)
+            return false;
 
-    TailLightReport featureReport;
-    featureReport.SetColor(color);
+        std::vector<BYTE> featureReport(m_layout.Report().size(), (BYTE)0);
+        featureReport[0] = TailLightLayout::READBACK_REPORT_ID;
+        featureReport[1] = 1; // observed in WireShark
+        featureReport[2] = 1; // observed in WireShark
+        featureReport[3] = 0; // observed in WireShark
+        featureReport[4] = 0x29; // observed in WireShark
+        featureReport[5] = 0; // observed in WireShark
+        BOOLEAN ok = HidD_GetFeature(m_dev, featureReport.data(), (ULONG)featureReport.size());
+        if (m_capture)
+            m_capture->Write(m_captureDevice, HidP_Feature, (uint8_t)(ok ? 0 : CAPTURE_FAILED), featureReport.data(), (uint16_t)featureReport.size());
+        if (!ok) {
+            DWORD err = GetLastError();
+            printf("ERROR: HidD_GetFeature failure (err %d).\n", err);
+            return false;
+        }
 
-    BOOLEAN ok = HidD_SetFeature(hid_dev, &featureReport, (ULONG)sizeof(featureReport));
-    if (!ok) {
-        DWORD err = GetLastError();
-        printf("ERROR: HidD_SetFeature failure (err %d).\n", err);
-        assert(ok);
-        return false;
+        BYTE red = 0, green = 0, blue = 0;
+        if (!TailLightLayout::DecodeReadback(featureReport.data(), featureReport.size(), red, green, blue))
+            return false; // unexpected response
+
+        color = RGB(red, green, blue);
+        return true;
+    }
+
+    /** Enable verify-after-write. The color is read back once per "interval" writes
+        (0 to disable) and compared with the last written color. */
+    void SetVerify(unsigned int interval) {
+        m_verifyInterval = interval;
+        m_unverified = 0;
     }
 
-    {
-        // TEST: Read input report
-        std::vector<BYTE> inputBuf(caps.InputReportByteLength, (BYTE)0);
+    /** Check that the device shows the last written color. Call after the last write to
+        verify any remaining writes. Returns true if there were no unverified writes.
+        Failed readbacks and color mismatches are counted separately.
+        Note that the filter driver power budget may reduce bright colors. */
+    bool Verify() {
+        if (m_unverified == 0)
+            return true;
+        m_unverified = 0;
+
+        COLORREF current = 0;
+        if (!Get(current)) {
+            m_readFailures++;
+            return false;
+        }
+        if (current != m_lastColor) {
+            m_mismatches++;
+            return false;
+        }
+        return true;
+    }
+
+    /** Number of verifications where the color was read back, but didn't match. */
+    unsigned int Mismatches() const {
+        return m_mismatches;
+    }
+
+    /** Number of verifications where the color couldn't be read back. */
+    unsigned int ReadFailures() const {
+        return m_readFailures;
+    }
+
+    /** Diagnostic: Read input report and check that the device echoes the control code.
+        Doubles USB traffic if called after every Set. */
+    bool Probe() const {
+        std::vector<BYTE> inputBuf(m_inputReportLength, (BYTE)0);
         inputBuf[0] = 0x27; // ReportID 39
-        ok = HidD_GetInputReport(hid_dev, inputBuf.data(), (ULONG)inputBuf.size());
-        assert(ok);
-        assert(inputBuf[1] == 0xB2);
+        BOOLEAN ok = HidD_GetInputReport(m_dev, inputBuf.data(), (ULONG)inputBuf.size());
+        if (m_capture)
+            m_capture->Write(m_captureDevice, HidP_Input, (uint8_t)(ok ? 0 : CAPTURE_FAILED), inputBuf.data(), (uint16_t)inputBuf.size());
+        if (!ok) {
+            DWORD err = GetLastError();
+            printf("ERROR: HidD_GetInputReport failure (err %d).\n", err);
+            return false;
+        }
         // the rest of inputBuf is still empty
+        return (inputBuf[1] == 0xB2);
+    }
+
+private:
+    HANDLE          m_dev = 0;
+    USHORT          m_inputReportLength = 0;
+    TailLightLayout m_layout;
+    bool            m_valid = false;
+    CaptureWriter*  m_capture = nullptr;
+    uint16_t        m_captureDevice = 0;
+    COLORREF        m_lastColor = 0;      // last written color
+    unsigned int    m_verifyInterval = 0; // writes per readback (0 if disabled)
+    unsigned int    m_unverified = 0;     // writes since last readback
+    unsigned int    m_mismatches = 0;
+    unsigned int    m_readFailures = 0;
+};
+
+
+bool GetTailLight(HANDLE hid_dev, PHIDP_PREPARSED_DATA reportDesc, HIDP_CAPS caps, COLORREF& color) {
+    TailLightWriter writer(hid_dev, reportDesc, caps);
+    if (!writer.IsValid())
+        return false;
+
+    return writer.Get(color);
+}
+
+
+bool UpdateTailLight(HANDLE hid_dev, PHIDP_PREPARSED_DATA reportDesc, HIDP_CAPS caps, COLORREF color, bool probe = false, CaptureWriter* capture = nullptr, uint16_t captureDevice = 0) {
+    TailLightWriter writer(hid_dev, reportDesc, caps);
+    if (!writer.IsValid())
+        return false;
+    writer.SetCapture(capture, captureDevice);
+
+    if (!writer.Set(color))
+        return false;
+
+    if (probe && !writer.Probe()) {
+        printf("ERROR: Input report probe failed.\n");
+        return false;
     }
 
     return true;
@@ -0,0 +1,123 @@
+#pragma once
+#ifndef _WIN32
+// Windows types used by the driver header
+typedef unsigned char UCHAR;
+typedef unsigned long ULONG;
+#endif
+#include "../TailLight/TailLight.h"
+#include "ReportCodec.hpp"
+
+
+/** Platform-independent tail-light feature report encoder.
+    Locates the TailLightReport fields through ReportCodec and keeps a pre-encoded report,
+    so that a color change only updates the three color bytes. */
+class TailLightLayout {
+public:
+    /** Report ID for reading back the current color. */
+    static constexpr uint8_t READBACK_REPORT_ID = 0x27; // 39
+
+    /** Decode color from a readback feature report.
+        As observed in captures, the response carries the TailLightReport fields after the report ID
+        (control codes followed by red, green and blue). Returns false if the control codes don't match. */
+    static bool DecodeReadback(const uint8_t* report, size_t length, uint8_t& red, uint8_t& green, uint8_t& blue) {
+        const TailLightReport defaults;
+        auto offset = [&defaults](const UCHAR& field) {
+            return (size_t)(&field - &defaults.ReportId);
+        };
+        if (length <= offset(defaults.Blue))
+            return false;
+        if ((report[0] != READBACK_REPORT_ID) || (report[offset(defaults.Unknown1)] != defaults.Unknown1) || (report[offset(defaults.Unknown2)] != defaults.Unknown2))
+            return false;
+
+        red = report[offset(defaults.Red)];
+        green = report[offset(defaults.Green)];
+        blue = report[offset(defaults.Blue)];
+        return true;
+    }
+
+    /** Locate fields. Returns false if the device doesn't have a compatible tail-light report.
+        Falls back to the fixed TailLightReport layout if the report length matches but the descriptor doesn't describe the fields. */
+    bool Init(const ReportCodec& codec) {
+        if (codec.ReportLength(ReportKind::Feature) != sizeof(TailLightReport))
+            return false; // length mismatch
+
+        // locate the byte fields following the report ID in TailLightReport
+        const TailLightReport defaults;
+        for (unsigned int i = 0; i < FIELD_COUNT; i++) {
+            const ReportField* field = codec.FindAt(ReportKind::Feature, defaults.ReportId, BitOffset(i), &m_fields[i].index);
+            if (!field || (field->bitSize != 8))
+                return InitFixed(); // unexpected layout
+
+            m_fields[i].field = *field;
+        }
+
+        PreEncode();
+        return true;
+    }
+
+    /** Use the fixed TailLightReport layout without consulting the report descriptor.
+        The caller is responsible for checking that the feature report length matches. */
+    bool InitFixed() {
+        const TailLightReport defaults;
+        for (unsigned int i = 0; i < FIELD_COUNT; i++) {
+            ReportField field;
+            field.kind = ReportKind::Feature;
+            field.reportId = defaults.ReportId;
+            field.bitSize = 8;
+            field.bitOffset = BitOffset(i);
+            field.logicalMax = 0xFF;
+            m_fields[i].field = field;
+            m_fields[i].index = 0;
+        }
+
+        PreEncode();
+        return true;
+    }
+
+    void SetColor(uint8_t red, uint8_t green, uint8_t blue) {
+        ReportCodec::Encode(m_fields[FIELD_RED].field, m_fields[FIELD_RED].index, red, m_report.data());
+        ReportCodec::Encode(m_fields[FIELD_GREEN].field, m_fields[FIELD_GREEN].index, green, m_report.data());
+        ReportCodec::Encode(m_fields[FIELD_BLUE].field, m_fields[FIELD_BLUE].index, blue, m_report.data());
+    }
+
+    /** Encoded feature report, starting with the report ID. */
+    const std::vector<uint8_t>& Report() const {
+        return m_report;
+    }
+
+private:
+    // TailLightReport fields after the report ID
+    enum {
+        FIELD_UNKNOWN1,
+        FIELD_UNKNOWN2,
+        FIELD_RED,
+        FIELD_GREEN,
+        FIELD_BLUE,
+        FIELD_COUNT,
+    };
+
+    struct FieldRef {
+        ReportField  field;
+        unsigned int index = 0; // element index within field
+    };
+
+    /** Bit offset of a field within TailLightReport. */
+    static uint32_t BitOffset(unsigned int idx) {
+        const TailLightReport defaults;
+        const UCHAR* fields[FIELD_COUNT] = {&defaults.Unknown1, &defaults.Unknown2, &defaults.Red, &defaults.Green, &defaults.Blue};
+        return 8 * (uint32_t)(fields[idx] - &defaults.ReportId);
+    }
+
+    /** Pre-encode report ID and control codes. */
+    void PreEncode() {
+        const TailLightReport defaults;
+        const UCHAR values[FIELD_RED] = {defaults.Unknown1, defaults.Unknown2};
+        m_report.assign(sizeof(TailLightReport), (uint8_t)0);
+        m_report[0] = defaults.ReportId;
+        for (unsigned int i = 0; i < FIELD_RED; i++)
+            ReportCodec::Encode(m_fields[i].field, m_fields[i].index, values[i], m_report.data());
+    }
+
+    FieldRef             m_fields[FIELD_COUNT];
+    std::vector<uint8_t> m_report; // pre-encoded feature report
+};
@@ -0,0 +1,85 @@
+#pragma once
+/** Public interface of the MouseMirror driver IOCTL fast path.
+    Shared between the driver and user-mode clients. User-mode clients must include
+    <windows.h> and <winioctl.h> first.
+    The mouse stack is opened exclusively by the raw input thread, so the IOCTLs are served by a
+    separate control device that applies settings to all MouseMirror devices. */
+
+/** Control device name in kernel and user mode. */
+#define MOUSEMIRROR_DEVICE_NAME     L"\\Device\\MouseMirror"
+#define MOUSEMIRROR_SYMBOLIC_NAME   L"\\DosDevices\\MouseMirror"
+#define MOUSEMIRROR_USER_PATH       L"\\\\.\\MouseMirror"
+
+/** Device type for MouseMirror IOCTLs (values below 0x8000 are reserved by Microsoft). */
+#define FILE_DEVICE_MOUSEMIRROR 0x8A25
+
+/** Set config of all mice. Input: MOUSEMIRROR_CONFIG. */
+#define IOCTL_MOUSEMIRROR_SET_CONFIG CTL_CODE(FILE_DEVICE_MOUSEMIRROR, 0x800, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+/** Get config and packet counters summed over all mice. Output: MOUSEMIRROR_STATS. */
+#define IOCTL_MOUSEMIRROR_GET_STATS  CTL_CODE(FILE_DEVICE_MOUSEMIRROR, 0x801, METHOD_BUFFERED, FILE_READ_ACCESS)
+/** Load profile slots and the switching chord of all mice. Input: MOUSEMIRROR_PROFILES.
+    The active profile is kept if still loaded (with its new settings), and otherwise reset to the first. */
+#define IOCTL_MOUSEMIRROR_SET_PROFILES   CTL_CODE(FILE_DEVICE_MOUSEMIRROR, 0x802, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+/** Activate a loaded profile on all mice. Input: MOUSEMIRROR_SELECT_PROFILE. */
+#define IOCTL_MOUSEMIRROR_SELECT_PROFILE CTL_CODE(FILE_DEVICE_MOUSEMIRROR, 0x803, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+
+/** MOUSEMIRROR_CONFIG flags. Same settings as the MouseMirrorDeviceInformation WMI class. */
+static constexpr ULONG MOUSEMIRROR_FLIP_LEFT_RIGHT = 0x1;
+static constexpr ULONG MOUSEMIRROR_FLIP_UP_DOWN    = 0x2;
+static constexpr ULONG MOUSEMIRROR_VALID_FLAGS     = MOUSEMIRROR_FLIP_LEFT_RIGHT | MOUSEMIRROR_FLIP_UP_DOWN;
+
+/** Mirroring settings. Flags outside MOUSEMIRROR_VALID_FLAGS are rejected.
+    Only changes the flips of the active settings. Scale and dead zone are kept. */
+struct MOUSEMIRROR_CONFIG {
+    ULONG Flags;
+};
+
+/** Movement transform settings. Packed into 32 bits, so that the driver can switch profile with a single atomic write.
+    A zero-initialized profile leaves movement unchanged. */
+struct MOUSEMIRROR_PROFILE {
+    UCHAR  Flags;    // MOUSEMIRROR_FLIP_Xxx (applied last)
+    UCHAR  DeadZone; // per-axis movement of at most this many counts is suppressed (applied first)
+    USHORT Scale;    // movement scale in 1/256 units (0 or 256 = unchanged)
+};
+static_assert(sizeof(MOUSEMIRROR_PROFILE) == sizeof(ULONG), "MOUSEMIRROR_PROFILE must fit in an atomic write");
+
+/** Scale value for unchanged movement. */
+static constexpr USHORT MOUSEMIRROR_SCALE_ONE = 256;
+
+/** Max number of profile slots per mouse. */
+static constexpr ULONG MOUSEMIRROR_MAX_PROFILES = 8;
+
+/** Buttons for the profile switching chord. */
+static constexpr ULONG MOUSEMIRROR_BUTTON_LEFT   = 0x01;
+static constexpr ULONG MOUSEMIRROR_BUTTON_RIGHT  = 0x02;
+static constexpr ULONG MOUSEMIRROR_BUTTON_MIDDLE = 0x04;
+static constexpr ULONG MOUSEMIRROR_BUTTON_X1     = 0x08;
+static constexpr ULONG MOUSEMIRROR_BUTTON_X2     = 0x10;
+static constexpr ULONG MOUSEMIRROR_VALID_BUTTONS = 0x1F;
+
+/** Profile slots. Pressing all ChordButtons switches to the next of the Count profiles.
+    The button events are still passed on. ChordButtons=0 disables chord switching. */
+struct MOUSEMIRROR_PROFILES {
+    ULONG               Count; // [1, MOUSEMIRROR_MAX_PROFILES]
+    ULONG               ChordButtons; // MOUSEMIRROR_BUTTON_Xxx
+    MOUSEMIRROR_PROFILE Profiles[MOUSEMIRROR_MAX_PROFILES];
+};
+
+/** Profile slot to activate. */
+struct MOUSEMIRROR_SELECT_PROFILE {
+    ULONG Index;
+};
+
+/** Driver statistics. */
+struct MOUSEMIRROR_STATS {
+    MOUSEMIRROR_CONFIG Config;        // config of the first mouse
+    ULONG              Devices;       // number of mice
+    ULONG              ConfigChanges; // config updates through WMI or IOCTL, and profile switches
+    ULONGLONG          Packets;       // mouse input packets filtered
+    ULONGLONG          Mirrored;      // relative movement packets with mirroring, scaling or dead zone applied
+
+    ULONG              ActiveProfile;     // active profile of the first mouse
+    ULONG              ProfileSwitches;   // profile switches through chord or IOCTL
+    ULONGLONG          SwitchTimeTotalNs; // time spent switching profile (including locking)
+    ULONGLONG          SwitchTimeMaxNs;
+};
@@ -0,0 +1,279 @@
+#include "driver.h"
+
+// Control device handling based on the toaster "sideband" filter sample in Windows-driver-samples.
+
+static WDFCOLLECTION FilterDevices = NULL;     // MouseMirror devices (accessed under FilterDevicesLock)
+static WDFWAITLOCK   FilterDevicesLock = NULL;
+static WDFDEVICE     ControlDevice = NULL;     // created with the first and deleted with the last device
+
+
+NTSTATUS ControlInitialize()
+{
+    // objects are parented to the driver by default
+    NTSTATUS status = WdfCollectionCreate(WDF_NO_OBJECT_ATTRIBUTES, &FilterDevices);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfCollectionCreate failed 0x%x\n", status));
+        return status;
+    }
+
+    status = WdfWaitLockCreate(WDF_NO_OBJECT_ATTRIBUTES, &FilterDevicesLock);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfWaitLockCreate failed 0x%x\n", status));
+        return status;
+    }
+
+    return status;
+}
+
+
+/** Create the control device for IOCTL_MOUSEMIRROR_Xxx requests. */
+static NTSTATUS CreateControlDevice(WDFDRIVER Driver)
+{
+    // same access as the WMI interface (WmiSecurity_AllFullAccess in the INF)
+    PWDFDEVICE_INIT deviceInit = WdfControlDeviceInitAllocate(Driver, &SDDL_DEVOBJ_SYS_ALL_ADM_RWX_WORLD_RW_RES_R);
+    if (!deviceInit) {
+        KdPrint(("MouseMirror: WdfControlDeviceInitAllocate failed\n"));
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    WdfDeviceInitSetExclusive(deviceInit, FALSE); // allow multiple clients
+
+    DECLARE_CONST_UNICODE_STRING(deviceName, MOUSEMIRROR_DEVICE_NAME);
+    NTSTATUS status = WdfDeviceInitAssignName(deviceInit, &deviceName);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfDeviceInitAssignName failed 0x%x\n", status));
+        WdfDeviceInitFree(deviceInit);
+        return status;
+    }
+
+    WDFDEVICE device = 0;
+    status = WdfDeviceCreate(&deviceInit, WDF_NO_OBJECT_ATTRIBUTES, &device);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfDeviceCreate (control) failed 0x%x\n", status));
+        WdfDeviceInitFree(deviceInit);
+        return status;
+    }
+
+    DECLARE_CONST_UNICODE_STRING(symbolicName, MOUSEMIRROR_SYMBOLIC_NAME);
+    status = WdfDeviceCreateSymbolicLink(device, &symbolicName);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfDeviceCreateSymbolicLink failed 0x%x\n", status));
+        WdfObjectDelete(device);
+        return status;
+    }
+
+    {
+        // create queue for IOCTL_MOUSEMIRROR_Xxx requests
+        WDF_IO_QUEUE_CONFIG queueConfig = {};
+        WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(&queueConfig, WdfIoQueueDispatchParallel);
+        queueConfig.EvtIoDeviceControl = EvtIoDeviceControlMouseMirror;
+
+        WDF_OBJECT_ATTRIBUTES attributes = {};
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ExecutionLevel = WdfExecutionLevelPassive; // required for FilterDevicesLock
+
+        WDFQUEUE queue = 0; // auto-deleted when parent is deleted
+        status = WdfIoQueueCreate(device, &queueConfig, &attributes, &queue);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("MouseMirror: WdfIoQueueCreate (control) failed 0x%x\n", status));
+            WdfObjectDelete(device);
+            return status;
+        }
+    }
+
+    WdfControlFinishInitializing(device);
+
+    ControlDevice = device;
+    KdPrint(("MouseMirror: Control device created\n"));
+    return status;
+}
+
+
+NTSTATUS ControlAddDevice(_In_ WDFDRIVER Driver, _In_ WDFDEVICE Device)
+{
+    WdfWaitLockAcquire(FilterDevicesLock, NULL);
+
+    NTSTATUS status = WdfCollectionAdd(FilterDevices, Device);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfCollectionAdd failed 0x%x\n", status));
+    } else if (!ControlDevice) {
+        // mirroring still works through WMI without the control device
+        NTSTATUS controlStatus = CreateControlDevice(Driver);
+        UNREFERENCED_PARAMETER(controlStatus);
+    }
+
+    WdfWaitLockRelease(FilterDevicesLock);
+    return status;
+}
+
+
+void ControlRemoveDevice(_In_ WDFDEVICE Device)
+{
+    WdfWaitLockAcquire(FilterDevicesLock, NULL);
+
+    ULONG count = WdfCollectionGetCount(FilterDevices);
+    for (ULONG i = 0; i < count; i++) {
+        if (WdfCollectionGetItem(FilterDevices, i) == Device) {
+            WdfCollectionRemoveItem(FilterDevices, i);
+            break;
+        }
+    }
+
+    if ((WdfCollectionGetCount(FilterDevices) == 0) && ControlDevice) {
+        WdfObjectDelete(ControlDevice);
+        ControlDevice = NULL;
+        KdPrint(("MouseMirror: Control device deleted\n"));
+    }
+
+    WdfWaitLockRelease(FilterDevicesLock);
+}
+
+
+static NTSTATUS SetConfigIoctl(WDFREQUEST Request) {
+    MOUSEMIRROR_CONFIG* input = nullptr;
+    NTSTATUS status = WdfRequestRetrieveInputBuffer(Request, sizeof(MOUSEMIRROR_CONFIG), (void**)&input, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfRequestRetrieveInputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    if (input->Flags & ~MOUSEMIRROR_VALID_FLAGS)
+        return STATUS_INVALID_PARAMETER;
+
+    WdfWaitLockAcquire(FilterDevicesLock, NULL);
+    ULONG count = WdfCollectionGetCount(FilterDevices);
+    for (ULONG i = 0; i < count; i++) {
+        WDFDEVICE device = (WDFDEVICE)WdfCollectionGetItem(FilterDevices, i);
+        DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(device);
+        SetMirrorFlags(deviceContext, input->Flags);
+        SaveSettingsAsync(deviceContext);
+    }
+    WdfWaitLockRelease(FilterDevicesLock);
+
+    return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS SetProfilesIoctl(WDFREQUEST Request) {
+    MOUSEMIRROR_PROFILES* input = nullptr;
+    NTSTATUS status = WdfRequestRetrieveInputBuffer(Request, sizeof(MOUSEMIRROR_PROFILES), (void**)&input, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfRequestRetrieveInputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    if ((input->Count == 0) || (input->Count > MOUSEMIRROR_MAX_PROFILES) || (input->ChordButtons & ~MOUSEMIRROR_VALID_BUTTONS))
+        return STATUS_INVALID_PARAMETER;
+    for (ULONG i = 0; i < input->Count; i++) {
+        if (input->Profiles[i].Flags & ~MOUSEMIRROR_VALID_FLAGS) {
+            KdPrint(("MouseMirror: Invalid profile %u (Flags=0x%x)\n", i, input->Profiles[i].Flags));
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    WdfWaitLockAcquire(FilterDevicesLock, NULL);
+    ULONG count = WdfCollectionGetCount(FilterDevices);
+    for (ULONG i = 0; i < count; i++) {
+        WDFDEVICE device = (WDFDEVICE)WdfCollectionGetItem(FilterDevices, i);
+        SetProfiles(WdfObjectGet_DEVICE_CONTEXT(device), *input);
+    }
+    WdfWaitLockRelease(FilterDevicesLock);
+
+    KdPrint(("MouseMirror: Loaded %u profiles (ChordButtons=0x%x)\n", input->Count, input->ChordButtons));
+    return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS SelectProfileIoctl(WDFREQUEST Request) {
+    MOUSEMIRROR_SELECT_PROFILE* input = nullptr;
+    NTSTATUS status = WdfRequestRetrieveInputBuffer(Request, sizeof(MOUSEMIRROR_SELECT_PROFILE), (void**)&input, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfRequestRetrieveInputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    WdfWaitLockAcquire(FilterDevicesLock, NULL);
+    ULONG count = WdfCollectionGetCount(FilterDevices);
+    for (ULONG i = 0; i < count; i++) {
+        WDFDEVICE device = (WDFDEVICE)WdfCollectionGetItem(FilterDevices, i);
+        if (!SelectProfile(WdfObjectGet_DEVICE_CONTEXT(device), input->Index))
+            status = STATUS_INVALID_PARAMETER; // slot not loaded on this mouse
+    }
+    WdfWaitLockRelease(FilterDevicesLock);
+
+    return status;
+}
+
+
+static NTSTATUS GetStatsIoctl(WDFREQUEST Request, size_t* bytesReturned) {
+    MOUSEMIRROR_STATS* output = nullptr;
+    NTSTATUS status = WdfRequestRetrieveOutputBuffer(Request, sizeof(MOUSEMIRROR_STATS), (void**)&output, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfRequestRetrieveOutputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    MOUSEMIRROR_STATS stats = {};
+    ULONGLONG switchTicksTotal = 0;
+    ULONGLONG switchTicksMax = 0;
+    WdfWaitLockAcquire(FilterDevicesLock, NULL);
+    stats.Devices = WdfCollectionGetCount(FilterDevices);
+    for (ULONG i = 0; i < stats.Devices; i++) {
+        WDFDEVICE device = (WDFDEVICE)WdfCollectionGetItem(FilterDevices, i);
+        DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(device);
+        if (i == 0) {
+            stats.Config.Flags = UnpackProfile(ReadNoFence(&deviceContext->Config)).Flags;
+            stats.ActiveProfile = deviceContext->ActiveProfile; // informational (not locked)
+        }
+        stats.ConfigChanges += (ULONG)ReadNoFence(&deviceContext->ConfigChanges);
+        stats.Packets += (ULONGLONG)ReadNoFence64(&deviceContext->Packets);
+        stats.Mirrored += (ULONGLONG)ReadNoFence64(&deviceContext->Mirrored);
+
+        stats.ProfileSwitches += (ULONG)ReadNoFence(&deviceContext->ProfileSwitches);
+        switchTicksTotal += (ULONGLONG)ReadNoFence64(&deviceContext->SwitchTicksTotal);
+        switchTicksMax = max(switchTicksMax, (ULONGLONG)ReadNoFence64(&deviceContext->SwitchTicksMax));
+    }
+    WdfWaitLockRelease(FilterDevicesLock);
+
+    // convert performance counter ticks to nanoseconds
+    LARGE_INTEGER frequency = {};
+    KeQueryPerformanceCounter(&frequency);
+    stats.SwitchTimeTotalNs = switchTicksTotal * 1000000000ull / (ULONGLONG)frequency.QuadPart;
+    stats.SwitchTimeMaxNs = switchTicksMax * 1000000000ull / (ULONGLONG)frequency.QuadPart;
+
+    *output = stats;
+    *bytesReturned = sizeof(MOUSEMIRROR_STATS);
+    return STATUS_SUCCESS;
+}
+
+
+VOID EvtIoDeviceControlMouseMirror(
+    _In_  WDFQUEUE          Queue,
+    _In_  WDFREQUEST        Request,
+    _In_  size_t            OutputBufferLength,
+    _In_  size_t            InputBufferLength,
+    _In_  ULONG             IoControlCode
+) {
+    UNREFERENCED_PARAMETER(Queue);
+    UNREFERENCED_PARAMETER(OutputBufferLength); // checked by WdfRequestRetrieveOutputBuffer
+    UNREFERENCED_PARAMETER(InputBufferLength);  // checked by WdfRequestRetrieveInputBuffer
+
+    size_t bytesReturned = 0;
+    NTSTATUS status = STATUS_INVALID_DEVICE_REQUEST;
+    switch (IoControlCode) {
+    case IOCTL_MOUSEMIRROR_SET_CONFIG:
+        status = SetConfigIoctl(Request);
+        break;
+    case IOCTL_MOUSEMIRROR_GET_STATS:
+        status = GetStatsIoctl(Request, &bytesReturned);
+        break;
+    case IOCTL_MOUSEMIRROR_SET_PROFILES:
+        status = SetProfilesIoctl(Request);
+        break;
+    case IOCTL_MOUSEMIRROR_SELECT_PROFILE:
+        status = SelectProfileIoctl(Request);
+        break;
+    }
+
+    WdfRequestCompleteWithInformation(Request, status, bytesReturned);
+}
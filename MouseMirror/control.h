@@ -0,0 +1,13 @@
+#pragma once
+
+/** Create the list of MouseMirror devices that the control device operates on.
+    Must be called from DriverEntry. */
+NTSTATUS ControlInitialize();
+
+/** Register a MouseMirror device. The control device is created together with the first device. */
+NTSTATUS ControlAddDevice(_In_ WDFDRIVER Driver, _In_ WDFDEVICE Device);
+
+/** Unregister a MouseMirror device. The control device is deleted together with the last device. */
+void ControlRemoveDevice(_In_ WDFDEVICE Device);
+
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL EvtIoDeviceControlMouseMirror;
@@ -17,8 +17,6 @@ Arguments:
     DeviceInit - Pointer to a framework-allocated WDFDEVICE_INIT structure.
 --*/    
 {
-    UNREFERENCED_PARAMETER(Driver);
-
     // Configure the device as a filter driver
     WdfFdoInitSetFilter(DeviceInit);
 
@@ -27,6 +25,7 @@ Arguments:
         // create device
         WDF_OBJECT_ATTRIBUTES attributes = {};
         WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DEVICE_CONTEXT);
+        attributes.EvtCleanupCallback = EvtDeviceContextCleanup;
 
         NTSTATUS status = WdfDeviceCreate(&DeviceInit, &attributes, &device);
         if (!NT_SUCCESS(status)) {
@@ -91,6 +90,18 @@ Arguments:
         }
     }
 
+    {
+        // initialize profile slots before any packets are filtered
+        NTSTATUS status = ProfileInitialize(device);
+        if (!NT_SUCCESS(status))
+            return status;
+
+        // restore settings from previous session, so that the first packets are already transformed
+        status = SettingsInitialize(device);
+        if (!NT_SUCCESS(status))
+            return status;
+    }
+
     // Initialize WMI provider
     NTSTATUS status = WmiInitialize(device);
     if (!NT_SUCCESS(status)) {
@@ -98,9 +109,24 @@ Arguments:
         return status;
     }
 
+    // make device reachable through the IOCTL control device
+    status = ControlAddDevice(Driver, device);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: Error registering device for IOCTLs 0x%x\n", status));
+        return status;
+    }
+
     return status;
 }
 
+
+VOID EvtDeviceContextCleanup(_In_ WDFOBJECT Device)
+{
+    KdPrint(("MouseMirror: EvtDeviceContextCleanup\n"));
+
+    ControlRemoveDevice((WDFDEVICE)Device);
+}
+
 VOID MouFilter_ServiceCallback(
     _In_ DEVICE_OBJECT* DeviceObject,
     _In_ MOUSE_INPUT_DATA* InputDataStart,
@@ -111,23 +137,37 @@ VOID MouFilter_ServiceCallback(
 
     WDFDEVICE device = WdfWdmDeviceGetWdfDeviceHandle(DeviceObject);
     DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(device);
-    MouseMirrorDeviceInformation* pInfo = WdfObjectGet_MouseMirrorDeviceInformation(deviceContext->WmiInstance);
+
+    // read settings once, so that all packets in the batch are processed consistently
+    // (a chord-triggered profile switch takes effect from the next batch)
+    const LONG packedConfig = ReadNoFence(&deviceContext->Config);
+    const MOUSEMIRROR_PROFILE config = UnpackProfile(packedConfig);
+    const bool transform = !IsIdentityProfile(config);
+
+    if (packedConfig != deviceContext->RemainderConfig) {
+        // don't carry sub-count movement scaled with the previous settings over to a new profile
+        deviceContext->RemainderX = 0;
+        deviceContext->RemainderY = 0;
+        deviceContext->RemainderConfig = packedConfig;
+    }
 
     // mirror mouse events in queue
+    LONG64 mirrored = 0;
     for (MOUSE_INPUT_DATA* id = InputDataStart; id != InputDataEnd; ++id) {
-        if (!(id->Flags & MOUSE_MOVE_ABSOLUTE)) {
-            // invert relative mouse movement
-            if (pInfo->FlipLeftRight)
-                id->LastX = -id->LastX;
-
-            if (pInfo->FlipUpDown)
-                id->LastY = -id->LastY;
+        if (!(id->Flags & MOUSE_MOVE_ABSOLUTE) && transform) {
+            // transform relative mouse movement
+            TransformMovement(deviceContext, config, id);
+            mirrored++;
         }
 
-        // TODO: Process button events:
-        //if (id->ButtonFlags & MOUSE_LEFT_BUTTON_DOWN)
+        if (id->ButtonFlags)
+            ProcessChord(deviceContext, id->ButtonFlags);
     }
 
+    InterlockedAdd64(&deviceContext->Packets, InputDataEnd - InputDataStart);
+    if (mirrored)
+        InterlockedAdd64(&deviceContext->Mirrored, mirrored);
+
     // UpperConnectData must be called at DISPATCH
     (*(PSERVICE_CALLBACK_ROUTINE)deviceContext->UpperConnectData.ClassService)
         (deviceContext->UpperConnectData.ClassDeviceObject, InputDataStart, InputDataEnd, InputDataConsumed);
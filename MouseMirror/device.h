@@ -6,9 +6,70 @@ struct DEVICE_CONTEXT {
     UNICODE_STRING PdoName;
     WDFWMIINSTANCE WmiInstance;
     CONNECT_DATA   UpperConnectData; // callback to intercept mouse packets
+
+    volatile LONG   Config;        // packed MOUSEMIRROR_PROFILE read by MouFilter_ServiceCallback. Only updated atomically.
+    volatile LONG   ConfigChanges;
+    volatile LONG64 Packets;       // mouse input packets filtered
+    volatile LONG64 Mirrored;      // relative movement packets with transform applied
+
+    // profile slots (accessed under ProfileLock)
+    WDFSPINLOCK     ProfileLock;
+    LONG            Profiles[MOUSEMIRROR_MAX_PROFILES]; // packed MOUSEMIRROR_PROFILE
+    ULONG           ProfileCount;
+    ULONG           ActiveProfile;
+    volatile LONG   ChordButtons;  // MOUSEMIRROR_BUTTON_Xxx
+
+    WDFWORKITEM     SaveWorkItem;  // persists settings in the hardware key
+
+    // switch cost measurement
+    volatile LONG   ProfileSwitches;
+    volatile LONG64 SwitchTicksTotal; // KeQueryPerformanceCounter ticks
+    volatile LONG64 SwitchTicksMax;
+
+    // only accessed from MouFilter_ServiceCallback
+    ULONG           ButtonState;   // MOUSEMIRROR_BUTTON_Xxx currently pressed
+    LONG            RemainderX;    // sub-count movement carried over when scaling
+    LONG            RemainderY;
+    LONG            RemainderConfig; // Config the remainders were accumulated with
 };
 WDF_DECLARE_CONTEXT_TYPE(DEVICE_CONTEXT)
 
 WDF_DECLARE_CONTEXT_TYPE(MouseMirrorDeviceInformation)
 
 EVT_WDF_DEVICE_CONTEXT_CLEANUP EvtDeviceContextCleanup;
+
+inline LONG PackProfile(MOUSEMIRROR_PROFILE profile) {
+    LONG value = 0;
+    RtlCopyMemory(&value, &profile, sizeof(value));
+    return value;
+}
+
+inline MOUSEMIRROR_PROFILE UnpackProfile(LONG value) {
+    MOUSEMIRROR_PROFILE profile = {};
+    RtlCopyMemory(&profile, &value, sizeof(profile));
+    return profile;
+}
+
+/** Clear and then set MOUSEMIRROR_FLIP_Xxx flags of the active profile. The stored profile slot is
+    updated together with Config, so that the change survives later profile switches. */
+inline void UpdateMirrorFlags(DEVICE_CONTEXT* deviceContext, ULONG clear, ULONG set) {
+    WdfSpinLockAcquire(deviceContext->ProfileLock);
+    LONG& slot = deviceContext->Profiles[deviceContext->ActiveProfile];
+    MOUSEMIRROR_PROFILE profile = UnpackProfile(slot);
+    profile.Flags = (UCHAR)((profile.Flags & ~clear) | set);
+    slot = PackProfile(profile);
+    InterlockedExchange(&deviceContext->Config, slot);
+    WdfSpinLockRelease(deviceContext->ProfileLock);
+
+    InterlockedIncrement(&deviceContext->ConfigChanges);
+}
+
+/** Replace the MOUSEMIRROR_FLIP_Xxx flags of the active profile. Takes effect from the next packet batch. */
+inline void SetMirrorFlags(DEVICE_CONTEXT* deviceContext, ULONG flags) {
+    UpdateMirrorFlags(deviceContext, 0xFF, flags);
+}
+
+/** Enable or disable a single MOUSEMIRROR_FLIP_Xxx flag without affecting the other settings. */
+inline void SetMirrorFlag(DEVICE_CONTEXT* deviceContext, ULONG flag, bool enable) {
+    UpdateMirrorFlags(deviceContext, flag, enable ? flag : 0);
+}
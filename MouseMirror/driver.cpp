@@ -15,16 +15,20 @@ NTSTATUS DriverEntry(
     params.EvtDriverUnload = EvtDriverUnload;
 
     // Create the framework WDFDRIVER object, with the handle to it returned in Driver.
+    WDFDRIVER driver = 0;
     NTSTATUS status = WdfDriverCreate(DriverObject, 
                              RegistryPath, 
                              WDF_NO_OBJECT_ATTRIBUTES, 
                              &params, 
-                             WDF_NO_HANDLE); // [out]
+                             &driver); // [out]
     if (!NT_SUCCESS(status)) {
         // Framework will automatically cleanup on error Status return
         KdPrint(("MouseMirror: Error Creating WDFDRIVER 0x%x\n", status));
+        return status;
     }
 
+    // device list for the IOCTL control device
+    status = ControlInitialize();
     return status;
 }
 
@@ -4,12 +4,18 @@
 #include <ntstrsafe.h>
 #include <initguid.h>
 #include <wdmguid.h>
+#include <wdmsec.h>
 
 // Generated WMI class definitions (from MouseMirror.mof)
 #include "MouseMirrormof.h"
 
+#include "MouseMirrorIoctl.h"
+
 #include "device.h"
+#include "profile.h"
+#include "settings.h"
 #include "wmi.h"
+#include "control.h"
 
 /** Memory allocation tag name (for debugging leaks). */
 static constexpr ULONG POOL_TAG = 'iMoM'; // displayed as "MoMi"
@@ -0,0 +1,145 @@
+#include "driver.h"
+
+
+NTSTATUS ProfileInitialize(_In_ WDFDEVICE Device)
+{
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+
+    WDF_OBJECT_ATTRIBUTES attributes = {};
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device; // auto-delete with device
+
+    NTSTATUS status = WdfSpinLockCreate(&attributes, &deviceContext->ProfileLock);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfSpinLockCreate failed 0x%x\n", status));
+        return status;
+    }
+
+    // zero-initialized context already contains an identity profile in slot 0
+    deviceContext->ProfileCount = 1;
+    return status;
+}
+
+
+void SetProfiles(_In_ DEVICE_CONTEXT* deviceContext, _In_ const MOUSEMIRROR_PROFILES& profiles)
+{
+    WdfSpinLockAcquire(deviceContext->ProfileLock);
+    for (ULONG i = 0; i < MOUSEMIRROR_MAX_PROFILES; i++)
+        deviceContext->Profiles[i] = (i < profiles.Count) ? PackProfile(profiles.Profiles[i]) : 0;
+    deviceContext->ProfileCount = profiles.Count;
+    if (deviceContext->ActiveProfile >= profiles.Count)
+        deviceContext->ActiveProfile = 0;
+
+    InterlockedExchange(&deviceContext->ChordButtons, (LONG)profiles.ChordButtons);
+    InterlockedExchange(&deviceContext->Config, deviceContext->Profiles[deviceContext->ActiveProfile]);
+    WdfSpinLockRelease(deviceContext->ProfileLock);
+
+    InterlockedIncrement(&deviceContext->ConfigChanges);
+    SaveSettingsAsync(deviceContext);
+}
+
+
+/** Atomically raise "target" to "value". */
+static void InterlockedMax64(volatile LONG64* target, LONG64 value) {
+    LONG64 prev = ReadNoFence64(target);
+    while (value > prev) {
+        LONG64 actual = InterlockedCompareExchange64(target, value, prev);
+        if (actual == prev)
+            break;
+        prev = actual;
+    }
+}
+
+
+bool SelectProfile(_In_ DEVICE_CONTEXT* deviceContext, _In_ ULONG index)
+{
+    LARGE_INTEGER start = KeQueryPerformanceCounter(NULL);
+
+    WdfSpinLockAcquire(deviceContext->ProfileLock);
+    bool loaded = index < deviceContext->ProfileCount;
+    if (loaded) {
+        deviceContext->ActiveProfile = index;
+        // the only write that MouFilter_ServiceCallback observes
+        InterlockedExchange(&deviceContext->Config, deviceContext->Profiles[index]);
+    }
+    WdfSpinLockRelease(deviceContext->ProfileLock);
+
+    if (!loaded)
+        return false;
+
+    LONG64 ticks = KeQueryPerformanceCounter(NULL).QuadPart - start.QuadPart;
+    InterlockedIncrement(&deviceContext->ProfileSwitches);
+    InterlockedIncrement(&deviceContext->ConfigChanges);
+    InterlockedAdd64(&deviceContext->SwitchTicksTotal, ticks);
+    InterlockedMax64(&deviceContext->SwitchTicksMax, ticks);
+
+    // persist outside the measured switch
+    SaveSettingsAsync(deviceContext);
+    return true;
+}
+
+
+void ProcessChord(_In_ DEVICE_CONTEXT* deviceContext, _In_ USHORT buttonFlags)
+{
+    // MOUSE_BUTTON_n_DOWN and MOUSE_BUTTON_n_UP are in bits 2*(n-1) and 2*(n-1)+1,
+    // in the same button order as MOUSEMIRROR_BUTTON_Xxx
+    const ULONG prevState = deviceContext->ButtonState;
+    ULONG state = prevState;
+    for (ULONG button = 0; button < 5; button++) {
+        if (buttonFlags & (MOUSE_BUTTON_1_DOWN << (2 * button)))
+            state |= (1u << button);
+        if (buttonFlags & (MOUSE_BUTTON_1_UP << (2 * button)))
+            state &= ~(1u << button);
+    }
+    deviceContext->ButtonState = state;
+
+    const ULONG chord = (ULONG)ReadNoFence(&deviceContext->ChordButtons);
+    if (!chord)
+        return; // chord switching disabled
+
+    // switch once when the last chord button is pressed
+    if (((state & chord) == chord) && ((prevState & chord) != chord)) {
+        WdfSpinLockAcquire(deviceContext->ProfileLock);
+        ULONG next = (deviceContext->ActiveProfile + 1) % deviceContext->ProfileCount;
+        WdfSpinLockRelease(deviceContext->ProfileLock);
+
+        SelectProfile(deviceContext, next);
+        KdPrint(("MouseMirror: Chord switched to profile %u\n", next));
+    }
+}
+
+
+/** Scale movement in 1/256 units, carrying the truncated remainder over to the next packet. */
+static LONG ScaleAxis(LONG value, USHORT scale, LONG& remainder) {
+    LONG64 total = (LONG64)value * scale + remainder;
+    LONG result = (LONG)(total / MOUSEMIRROR_SCALE_ONE);
+    remainder = (LONG)(total - (LONG64)result * MOUSEMIRROR_SCALE_ONE);
+    return result;
+}
+
+
+void TransformMovement(_In_ DEVICE_CONTEXT* deviceContext, _In_ MOUSEMIRROR_PROFILE profile, _Inout_ MOUSE_INPUT_DATA* id)
+{
+    LONG x = id->LastX;
+    LONG y = id->LastY;
+
+    if (profile.DeadZone) {
+        if ((x <= profile.DeadZone) && (x >= -(LONG)profile.DeadZone))
+            x = 0;
+        if ((y <= profile.DeadZone) && (y >= -(LONG)profile.DeadZone))
+            y = 0;
+    }
+
+    if (profile.Scale && (profile.Scale != MOUSEMIRROR_SCALE_ONE)) {
+        x = ScaleAxis(x, profile.Scale, deviceContext->RemainderX);
+        y = ScaleAxis(y, profile.Scale, deviceContext->RemainderY);
+    }
+
+    if (profile.Flags & MOUSEMIRROR_FLIP_LEFT_RIGHT)
+        x = -x;
+    if (profile.Flags & MOUSEMIRROR_FLIP_UP_DOWN)
+        y = -y;
+
+    id->LastX = x;
+    id->LastY = y;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+/** Create the profile lock. Starts with a single profile that leaves movement unchanged. */
+NTSTATUS ProfileInitialize(_In_ WDFDEVICE Device);
+
+/** Replace profile slots and switching chord. Input must be validated by the caller. */
+void SetProfiles(_In_ DEVICE_CONTEXT* deviceContext, _In_ const MOUSEMIRROR_PROFILES& profiles);
+
+/** Activate a profile slot with a single write to DEVICE_CONTEXT::Config.
+    Callable at IRQL <= DISPATCH_LEVEL. Returns false if the slot is not loaded. */
+bool SelectProfile(_In_ DEVICE_CONTEXT* deviceContext, _In_ ULONG index);
+
+/** Track button state and switch to the next profile when the chord is pressed.
+    Called from MouFilter_ServiceCallback for packets with button events. */
+void ProcessChord(_In_ DEVICE_CONTEXT* deviceContext, _In_ USHORT buttonFlags);
+
+/** Apply dead zone, scale and flips of "profile" to relative movement. */
+void TransformMovement(_In_ DEVICE_CONTEXT* deviceContext, _In_ MOUSEMIRROR_PROFILE profile, _Inout_ MOUSE_INPUT_DATA* id);
+
+/** Returns true if "profile" leaves movement unchanged. */
+inline bool IsIdentityProfile(MOUSEMIRROR_PROFILE profile) {
+    return !(profile.Flags & MOUSEMIRROR_VALID_FLAGS) && (profile.DeadZone == 0) && ((profile.Scale == 0) || (profile.Scale == MOUSEMIRROR_SCALE_ONE));
+}
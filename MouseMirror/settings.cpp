@@ -0,0 +1,141 @@
+#include "driver.h"
+
+
+/** Persisted settings layout (REG_BINARY). Only ProfileCount profiles are stored,
+    so the value is 8-36 bytes and can be loaded with a single small registry read. */
+struct PERSISTED_SETTINGS {
+    UCHAR Version;       // PERSISTED_SETTINGS_VERSION
+    UCHAR ProfileCount;  // [1, MOUSEMIRROR_MAX_PROFILES]
+    UCHAR ActiveProfile;
+    UCHAR ChordButtons;  // MOUSEMIRROR_BUTTON_Xxx
+    LONG  Profiles[MOUSEMIRROR_MAX_PROFILES]; // packed MOUSEMIRROR_PROFILE
+};
+
+static constexpr UCHAR PERSISTED_SETTINGS_VERSION = 2; // version 1 also stored Config, which always equals Profiles[ActiveProfile]
+
+/** Size of the stored value with "count" profiles. */
+static constexpr ULONG PersistedSize(ULONG count) {
+    return FIELD_OFFSET(PERSISTED_SETTINGS, Profiles) + count * sizeof(LONG);
+}
+
+
+static bool IsValidProfile(LONG packed) {
+    return !(UnpackProfile(packed).Flags & ~MOUSEMIRROR_VALID_FLAGS);
+}
+
+static bool IsValidSettings(const PERSISTED_SETTINGS& settings, ULONG length) {
+    if ((length < PersistedSize(0)) || (settings.Version != PERSISTED_SETTINGS_VERSION))
+        return false;
+    if ((settings.ProfileCount == 0) || (settings.ProfileCount > MOUSEMIRROR_MAX_PROFILES) || (length != PersistedSize(settings.ProfileCount)))
+        return false;
+    if ((settings.ActiveProfile >= settings.ProfileCount) || (settings.ChordButtons & ~MOUSEMIRROR_VALID_BUTTONS))
+        return false;
+    for (ULONG i = 0; i < settings.ProfileCount; i++) {
+        if (!IsValidProfile(settings.Profiles[i]))
+            return false;
+    }
+    return true;
+}
+
+
+/** Load persisted settings. Keeps the defaults if there are no valid settings. */
+static void LoadSettings(WDFDEVICE Device) {
+    WDFKEY key = 0;
+    NTSTATUS status = WdfDeviceOpenRegistryKey(Device, PLUGPLAY_REGKEY_DEVICE, KEY_READ, WDF_NO_OBJECT_ATTRIBUTES, &key);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfDeviceOpenRegistryKey failed 0x%x\n", status));
+        return;
+    }
+
+    DECLARE_CONST_UNICODE_STRING(valueName, SETTINGS_VALUE_NAME);
+    PERSISTED_SETTINGS settings = {};
+    ULONG length = 0;
+    ULONG type = 0;
+    status = WdfRegistryQueryValue(key, &valueName, sizeof(settings), &settings, &length, &type);
+    WdfRegistryClose(key);
+    if (!NT_SUCCESS(status)) {
+        if (status != STATUS_OBJECT_NAME_NOT_FOUND)
+            KdPrint(("MouseMirror: WdfRegistryQueryValue failed 0x%x\n", status));
+        return; // not saved yet
+    }
+
+    if ((type != REG_BINARY) || !IsValidSettings(settings, length)) {
+        KdPrint(("MouseMirror: Ignoring invalid persisted settings (length=%u)\n", length));
+        return;
+    }
+
+    // no packets are filtered yet, but keep Config updates atomic
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+    WdfSpinLockAcquire(deviceContext->ProfileLock);
+    RtlCopyMemory(deviceContext->Profiles, settings.Profiles, settings.ProfileCount * sizeof(LONG));
+    deviceContext->ProfileCount = settings.ProfileCount;
+    deviceContext->ActiveProfile = settings.ActiveProfile;
+    InterlockedExchange(&deviceContext->ChordButtons, settings.ChordButtons);
+    InterlockedExchange(&deviceContext->Config, deviceContext->Profiles[settings.ActiveProfile]);
+    WdfSpinLockRelease(deviceContext->ProfileLock);
+
+    KdPrint(("MouseMirror: Loaded persisted settings (profiles=%u, active=%u)\n", settings.ProfileCount, settings.ActiveProfile));
+}
+
+
+NTSTATUS SettingsInitialize(_In_ WDFDEVICE Device)
+{
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+
+    {
+        // create work item for saving settings, since the registry is only accessible at PASSIVE_LEVEL
+        WDF_WORKITEM_CONFIG workitemConfig = {};
+        WDF_WORKITEM_CONFIG_INIT(&workitemConfig, SaveSettingsWorkItem);
+
+        WDF_OBJECT_ATTRIBUTES attributes = {};
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device; // auto-delete with device
+
+        NTSTATUS status = WdfWorkItemCreate(&workitemConfig, &attributes, &deviceContext->SaveWorkItem);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("MouseMirror: WdfWorkItemCreate failed 0x%x\n", status));
+            return status;
+        }
+    }
+
+    LoadSettings(Device);
+    return STATUS_SUCCESS;
+}
+
+
+void SaveSettingsAsync(_In_ DEVICE_CONTEXT* deviceContext)
+{
+    // no-op if already queued. The work item saves the settings at the time it runs.
+    WdfWorkItemEnqueue(deviceContext->SaveWorkItem);
+}
+
+
+VOID SaveSettingsWorkItem(_In_ WDFWORKITEM WorkItem)
+{
+    WDFDEVICE device = (WDFDEVICE)WdfWorkItemGetParentObject(WorkItem);
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(device);
+
+    PERSISTED_SETTINGS settings = {};
+    settings.Version = PERSISTED_SETTINGS_VERSION;
+    WdfSpinLockAcquire(deviceContext->ProfileLock);
+    settings.ProfileCount = (UCHAR)deviceContext->ProfileCount;
+    settings.ActiveProfile = (UCHAR)deviceContext->ActiveProfile;
+    settings.ChordButtons = (UCHAR)ReadNoFence(&deviceContext->ChordButtons);
+    RtlCopyMemory(settings.Profiles, deviceContext->Profiles, deviceContext->ProfileCount * sizeof(LONG));
+    WdfSpinLockRelease(deviceContext->ProfileLock);
+
+    WDFKEY key = 0;
+    NTSTATUS status = WdfDeviceOpenRegistryKey(device, PLUGPLAY_REGKEY_DEVICE, KEY_WRITE, WDF_NO_OBJECT_ATTRIBUTES, &key);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfDeviceOpenRegistryKey failed 0x%x\n", status));
+        return;
+    }
+
+    DECLARE_CONST_UNICODE_STRING(valueName, SETTINGS_VALUE_NAME);
+    status = WdfRegistryAssignValue(key, &valueName, REG_BINARY, PersistedSize(settings.ProfileCount), &settings);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("MouseMirror: WdfRegistryAssignValue failed 0x%x\n", status));
+    }
+
+    WdfRegistryClose(key);
+}
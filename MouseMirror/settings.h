@@ -0,0 +1,13 @@
+#pragma once
+
+/** Registry value in the device hardware key with persisted settings. */
+#define SETTINGS_VALUE_NAME L"MouseMirrorSettings"
+
+/** Create the save work item and load persisted settings into the hot-path config.
+    Must be called after ProfileInitialize and before the device receives IOCTL_INTERNAL_MOUSE_CONNECT. */
+NTSTATUS SettingsInitialize(_In_ WDFDEVICE Device);
+
+/** Schedule saving of the current settings. Callable at IRQL <= DISPATCH_LEVEL. */
+void SaveSettingsAsync(_In_ DEVICE_CONTEXT* deviceContext);
+
+EVT_WDF_WORKITEM SaveSettingsWorkItem;
@@ -36,6 +36,12 @@ NTSTATUS WmiInitialize(_In_ WDFDEVICE Device)
     DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
     deviceContext->WmiInstance = WmiInstance;
 
+    // reflect persisted settings (also refreshed on every query)
+    MouseMirrorDeviceInformation* pInfo = WdfObjectGet_MouseMirrorDeviceInformation(WmiInstance);
+    const MOUSEMIRROR_PROFILE config = UnpackProfile(ReadNoFence(&deviceContext->Config));
+    pInfo->FlipLeftRight = (config.Flags & MOUSEMIRROR_FLIP_LEFT_RIGHT) ? TRUE : FALSE;
+    pInfo->FlipUpDown = (config.Flags & MOUSEMIRROR_FLIP_UP_DOWN) ? TRUE : FALSE;
+
     return status;
 }
 
@@ -50,7 +56,13 @@ NTSTATUS EvtWmiInstanceQueryInstance(
 
     KdPrint(("MouseMirror: WMI QueryInstance\n"));
 
+    // report the settings used by MouFilter_ServiceCallback, that might have been changed through IOCTLs
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(WdfWmiInstanceGetDevice(WmiInstance));
+    const ULONG config = (ULONG)ReadNoFence(&deviceContext->Config);
+
     MouseMirrorDeviceInformation* pInfo = WdfObjectGet_MouseMirrorDeviceInformation(WmiInstance);
+    pInfo->FlipLeftRight = (config & MOUSEMIRROR_FLIP_LEFT_RIGHT) ? TRUE : FALSE;
+    pInfo->FlipUpDown = (config & MOUSEMIRROR_FLIP_UP_DOWN) ? TRUE : FALSE;
     RtlCopyMemory(/*dst*/OutBuffer, /*src*/pInfo, sizeof(*pInfo));
     *BufferUsed = sizeof(*pInfo);
 
@@ -71,6 +83,16 @@ NTSTATUS EvtWmiInstanceSetInstance(
     MouseMirrorDeviceInformation* pInfo = WdfObjectGet_MouseMirrorDeviceInformation(WmiInstance);
     RtlCopyMemory(/*dst*/pInfo, /*src*/InBuffer, sizeof(*pInfo));
 
+    // apply both flips in a single update
+    ULONG config = 0;
+    if (pInfo->FlipLeftRight)
+        config |= MOUSEMIRROR_FLIP_LEFT_RIGHT;
+    if (pInfo->FlipUpDown)
+        config |= MOUSEMIRROR_FLIP_UP_DOWN;
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(WdfWmiInstanceGetDevice(WmiInstance));
+    SetMirrorFlags(deviceContext, config);
+    SaveSettingsAsync(deviceContext);
+
     KdPrint(("MouseMirror: WMI SetInstance completed\n"));
     return STATUS_SUCCESS;
 }
@@ -85,6 +107,7 @@ NTSTATUS EvtWmiInstanceSetItem(
     KdPrint(("MouseMirror: WMI SetItem\n"));
 
     MouseMirrorDeviceInformation* pInfo = WdfObjectGet_MouseMirrorDeviceInformation(WmiInstance);
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(WdfWmiInstanceGetDevice(WmiInstance));
     NTSTATUS status = STATUS_SUCCESS;
 
     if (DataItemId == MouseMirrorDeviceInformation_FlipLeftRight_ID) {
@@ -92,15 +115,19 @@ NTSTATUS EvtWmiInstanceSetItem(
             return STATUS_BUFFER_TOO_SMALL;
 
         pInfo->FlipLeftRight = *(BOOLEAN*)InBuffer;
+        SetMirrorFlag(deviceContext, MOUSEMIRROR_FLIP_LEFT_RIGHT, pInfo->FlipLeftRight);
     } else if (DataItemId == MouseMirrorDeviceInformation_FlipUpDown_ID) {
         if (InBufferSize < MouseMirrorDeviceInformation_FlipUpDown_SIZE)
             return STATUS_BUFFER_TOO_SMALL;
 
         pInfo->FlipUpDown = *(BOOLEAN*)InBuffer;
+        SetMirrorFlag(deviceContext, MOUSEMIRROR_FLIP_UP_DOWN, pInfo->FlipUpDown);
     } else {
         return STATUS_INVALID_DEVICE_REQUEST;
     }
 
+    SaveSettingsAsync(deviceContext);
+
     KdPrint(("MouseMirror: WMI SetItem completed\n"));
     return status;
 }
@@ -1,24 +1,25 @@
 #pragma once
+#include "PoolAllocator.hpp"
 
-/* This codes assumes that POOL_TAG have already been defined if building in kernel-mode. */
+/* This codes assumes that PoolInitialize have already been called if building in kernel-mode. */
 
 #ifdef _KERNEL_MODE
 void* operator new (size_t size) noexcept {
-    // allocate in non-paged pool (will always reside in RAM)
-    return ExAllocatePool2(POOL_FLAG_NON_PAGED, size, POOL_TAG);
+    // allocate from size-class lookaside lists in non-paged pool (will always reside in RAM)
+    return PoolAllocate(size);
 }
 
 void* operator new[] (size_t size) noexcept {
-    // allocate in non-paged pool (will always reside in RAM)
-    return ExAllocatePool2(POOL_FLAG_NON_PAGED, size, POOL_TAG);
+    // allocate from size-class lookaside lists in non-paged pool (will always reside in RAM)
+    return PoolAllocate(size);
 }
 
 void operator delete (void *ptr, size_t /*size*/) noexcept {
-    return ExFreePool(ptr);
+    return PoolFree(ptr);
 }
 
 void operator delete[] (void* ptr) noexcept {
-    return ExFreePool(ptr);
+    return PoolFree(ptr);
 }
 
 #endif // _KERNEL_MODE
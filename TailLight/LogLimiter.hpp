@@ -0,0 +1,89 @@
+#pragma once
+
+/** Token-bucket rate limiter that aggregates safety events between log entries.
+    Each log entry summarizes all events since the previous entry. A small burst
+    of entries is allowed, after which at most one entry is written per interval.
+    Has no WDK dependencies and is valid when zero-initialized. */
+class LogLimiter {
+public:
+    /** Max number of log entries in a burst. */
+    static constexpr unsigned int BUCKET_SIZE = 3;
+    /** Token refill interval in 100ns units (10 seconds). */
+    static constexpr unsigned long long INTERVAL = 10ull * 1000 * 1000 * 10;
+
+    /** Aggregated events since last log entry. */
+    struct Summary {
+        unsigned int Count;           // number of events
+        unsigned int FirstColor;      // first requested color (0xBBGGRR)
+        unsigned int LastColor;       // last requested color (0xBBGGRR)
+        unsigned int WorstSaturation; // max requested R+G+B sum
+    };
+
+    enum Action {
+        None,     // event aggregated, flush already scheduled
+        Emit,     // write log entry now (call Take)
+        Schedule, // schedule a flush after Delay() and call Flush then
+    };
+
+    /** Record an event. "now" is a monotonic timestamp in 100ns units. */
+    Action Record(unsigned long long now, unsigned int color, unsigned int saturation) {
+        if (m_summary.Count == 0)
+            m_summary.FirstColor = color;
+        m_summary.Count++;
+        m_summary.LastColor = color;
+        if (saturation > m_summary.WorstSaturation)
+            m_summary.WorstSaturation = saturation;
+
+        if (m_scheduled)
+            return None;
+
+        return Flush(now);
+    }
+
+    /** Called when a scheduled flush is due. */
+    Action Flush(unsigned long long now) {
+        m_scheduled = false;
+        if (m_summary.Count == 0)
+            return None;
+
+        Refill(now);
+        if (m_tokens > 0) {
+            m_tokens--;
+            return Emit;
+        }
+
+        m_scheduled = true;
+        return Schedule;
+    }
+
+    /** Time in 100ns units until the next token is available. */
+    unsigned long long Delay(unsigned long long now) const {
+        unsigned long long due = m_refillTime + INTERVAL;
+        return (due > now) ? due - now : 0;
+    }
+
+    /** Retrieve and reset aggregated events. */
+    Summary Take() {
+        Summary result = m_summary;
+        m_summary = {};
+        return result;
+    }
+
+private:
+    void Refill(unsigned long long now) {
+        unsigned long long elapsed = (now > m_refillTime) ? now - m_refillTime : 0;
+        unsigned long long tokens = elapsed / INTERVAL;
+        if (m_tokens + tokens >= BUCKET_SIZE) {
+            m_tokens = BUCKET_SIZE;
+            m_refillTime = now;
+        } else {
+            m_tokens += static_cast<unsigned int>(tokens);
+            m_refillTime += tokens * INTERVAL;
+        }
+    }
+
+    Summary            m_summary = {};
+    unsigned int       m_tokens = 0;
+    unsigned long long m_refillTime = 0; // time of last token refill
+    bool               m_scheduled = false;
+};
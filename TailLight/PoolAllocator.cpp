@@ -0,0 +1,160 @@
+#ifdef _KERNEL_MODE
+#include <ntddk.h>
+#else
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+#include "PoolAllocator.hpp"
+
+
+#ifdef _KERNEL_MODE
+using PoolCounter = volatile LONG;
+
+static unsigned int CounterAdd(PoolCounter& counter, LONG delta) {
+    return (unsigned int)InterlockedAdd(&counter, delta);
+}
+
+static void CounterMax(PoolCounter& counter, unsigned int value) {
+    LONG prev = counter;
+    while ((unsigned int)prev < value) {
+        LONG cur = InterlockedCompareExchange(&counter, (LONG)value, prev);
+        if (cur == prev)
+            break;
+        prev = cur;
+    }
+}
+#else
+using PoolCounter = std::atomic<long>;
+
+static unsigned int CounterAdd(PoolCounter& counter, long delta) {
+    return (unsigned int)(counter.fetch_add(delta) + delta);
+}
+
+static void CounterMax(PoolCounter& counter, unsigned int value) {
+    long prev = counter.load();
+    while (((unsigned int)prev < value) && !counter.compare_exchange_weak(prev, (long)value)) {
+    }
+}
+#endif
+
+/** Header stored in front of each block to find its size class on free.
+    16 bytes to preserve allocation alignment. */
+struct PoolHeader {
+    unsigned int ClassIdx;
+    unsigned int Reserved[3];
+};
+static_assert(sizeof(PoolHeader) == 16, "PoolHeader size mismatch");
+
+struct PoolClass {
+#ifdef _KERNEL_MODE
+    LOOKASIDE_LIST_EX Lookaside;
+#endif
+    PoolCounter Allocations;
+    PoolCounter Outstanding;
+    PoolCounter HighWater;
+    PoolCounter Failures;
+};
+
+static PoolClass s_classes[POOL_CLASS_COUNT];
+static bool      s_initialized = false;
+
+
+static unsigned int GetClassIdx(size_t size) {
+    for (unsigned int i = 0; i < POOL_CLASS_COUNT - 1; i++) {
+        if (size <= POOL_BLOCK_SIZES[i])
+            return i;
+    }
+    return POOL_CLASS_COUNT - 1; // non-pooled
+}
+
+
+bool PoolInitialize() {
+#ifdef _KERNEL_MODE
+    for (unsigned int i = 0; i < POOL_CLASS_COUNT - 1; i++) {
+        NTSTATUS status = ExInitializeLookasideListEx(&s_classes[i].Lookaside, NULL, NULL, NonPagedPoolNx, 0, sizeof(PoolHeader) + POOL_BLOCK_SIZES[i], POOL_CLASS_TAGS[i], 0);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("TailLight: ExInitializeLookasideListEx failed 0x%x\n", status));
+            while (i-- > 0)
+                ExDeleteLookasideListEx(&s_classes[i].Lookaside);
+            return false;
+        }
+    }
+#endif
+    s_initialized = true;
+    return true;
+}
+
+void PoolCleanup() {
+    if (!s_initialized)
+        return;
+
+    for (unsigned int i = 0; i < POOL_CLASS_COUNT; i++) {
+        if (s_classes[i].Outstanding != 0) {
+#ifdef _KERNEL_MODE
+            KdPrint(("TailLight: Pool tag 0x%x leaked %u blocks\n", POOL_CLASS_TAGS[i], (unsigned int)s_classes[i].Outstanding));
+#else
+            fprintf(stderr, "Pool tag 0x%lx leaked %u blocks\n", POOL_CLASS_TAGS[i], (unsigned int)s_classes[i].Outstanding);
+#endif
+        }
+#ifdef _KERNEL_MODE
+        if (i < POOL_CLASS_COUNT - 1)
+            ExDeleteLookasideListEx(&s_classes[i].Lookaside);
+#endif
+    }
+    s_initialized = false;
+}
+
+void* PoolAllocate(size_t size) {
+    unsigned int idx = GetClassIdx(size);
+    PoolClass& pc = s_classes[idx];
+
+    PoolHeader* header = nullptr;
+#ifdef _KERNEL_MODE
+    if (idx < POOL_CLASS_COUNT - 1)
+        header = (PoolHeader*)ExAllocateFromLookasideListEx(&pc.Lookaside);
+    else
+        header = (PoolHeader*)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(PoolHeader) + size, POOL_CLASS_TAGS[idx]);
+#else
+    header = (PoolHeader*)malloc(sizeof(PoolHeader) + (idx < POOL_CLASS_COUNT - 1 ? POOL_BLOCK_SIZES[idx] : size));
+#endif
+    if (!header) {
+        CounterAdd(pc.Failures, 1);
+        return nullptr;
+    }
+
+    header->ClassIdx = idx;
+    CounterAdd(pc.Allocations, 1);
+    CounterMax(pc.HighWater, CounterAdd(pc.Outstanding, 1));
+    return header + 1;
+}
+
+void PoolFree(void* ptr) {
+    if (!ptr)
+        return;
+
+    PoolHeader* header = (PoolHeader*)ptr - 1;
+    unsigned int idx = header->ClassIdx;
+    PoolClass& pc = s_classes[idx];
+    CounterAdd(pc.Outstanding, -1);
+
+#ifdef _KERNEL_MODE
+    if (idx < POOL_CLASS_COUNT - 1)
+        ExFreeToLookasideListEx(&pc.Lookaside, header);
+    else
+        ExFreePool(header);
+#else
+    free(header);
+#endif
+}
+
+void PoolGetStatistics(PoolClassStatistics (&stats)[POOL_CLASS_COUNT]) {
+    for (unsigned int i = 0; i < POOL_CLASS_COUNT; i++) {
+        stats[i].Tag = (unsigned int)POOL_CLASS_TAGS[i];
+        stats[i].BlockSize = POOL_BLOCK_SIZES[i];
+        stats[i].Allocations = (unsigned int)s_classes[i].Allocations;
+        stats[i].Outstanding = (unsigned int)s_classes[i].Outstanding;
+        stats[i].HighWater = (unsigned int)s_classes[i].HighWater;
+        stats[i].Failures = (unsigned int)s_classes[i].Failures;
+    }
+}
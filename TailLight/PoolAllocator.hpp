@@ -0,0 +1,46 @@
+#pragma once
+#include <stddef.h>
+
+/* Size-class pool allocator with per-tag accounting.
+   Small blocks are recycled through one lookaside list per size class, so that
+   frequent short-lived allocations (like preparsed data in SetFeatureColor)
+   avoid the general pool. Larger blocks fall back to the general pool.
+   Builds in both kernel-mode (lookaside lists) and user-mode (malloc). */
+
+/** Block sizes for the pooled size classes. The last class is for larger blocks. */
+static constexpr unsigned int POOL_BLOCK_SIZES[] = {64, 256, 1024, 4096, 0};
+static constexpr unsigned int POOL_CLASS_COUNT = sizeof(POOL_BLOCK_SIZES)/sizeof(POOL_BLOCK_SIZES[0]);
+
+/** Pool tag for each size class. */
+static constexpr unsigned long POOL_CLASS_TAGS[POOL_CLASS_COUNT] = {
+    '0LaT', // displayed as "TaL0"
+    '1LaT', // displayed as "TaL1"
+    '2LaT', // displayed as "TaL2"
+    '3LaT', // displayed as "TaL3"
+    'iLaT', // displayed as "TaLi" (same as POOL_TAG)
+};
+
+/** Accounting snapshot for one size class. */
+struct PoolClassStatistics {
+    unsigned int Tag;
+    unsigned int BlockSize;   // 0 for non-pooled blocks
+    unsigned int Allocations; // total number of allocations
+    unsigned int Outstanding; // currently allocated blocks (leaks if non-zero at unload)
+    unsigned int HighWater;   // max simultaneously allocated blocks
+    unsigned int Failures;    // failed allocations
+};
+
+/** Initialize lookaside lists. Call once before the first allocation. */
+bool PoolInitialize();
+
+/** Delete lookaside lists. Reports outstanding allocations in debug builds. */
+void PoolCleanup();
+
+/** Allocate a block of at least "size" bytes. Returns nullptr on failure. */
+void* PoolAllocate(size_t size);
+
+/** Free a block returned by PoolAllocate. Accepts nullptr. */
+void PoolFree(void* ptr);
+
+/** Retrieve accounting snapshot for all size classes. */
+void PoolGetStatistics(PoolClassStatistics (&stats)[POOL_CLASS_COUNT]);
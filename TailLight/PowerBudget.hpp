@@ -0,0 +1,75 @@
+#pragma once
+
+/** Integrating tail-light power model.
+    Tracks an exponential moving average (EMA) of the R+G+B channel sum to
+    limit sustained LED brightness, and scales colors down proportionally
+    instead of rejecting them when the budget is exhausted.
+    Integer fixed-point only, so that it can be evaluated on every feature write
+    in kernel-mode. Has no WDK dependencies and is valid when zero-initialized. */
+class PowerBudget {
+public:
+    /** Max R+G+B sum for a single frame. */
+    static constexpr unsigned int PEAK_LIMIT = 640;
+    /** Max R+G+B sum averaged over the time window. */
+    static constexpr unsigned int SUSTAINED_LIMIT = 384;
+    /** EMA time constant in 100ns units (10 seconds). */
+    static constexpr unsigned long long WINDOW = 10ull * 1000 * 1000 * 10;
+
+    /** Scale color to fit within the power budget.
+        "now" is a monotonic timestamp in 100ns units (e.g. KeQueryInterruptTime).
+        Returns false if the color was reduced. */
+    bool Apply(unsigned long long now, unsigned char& red, unsigned char& green, unsigned char& blue) {
+        // integrate the previous color over the time it was shown
+        Integrate(now);
+
+        unsigned int sum = red + green + blue;
+        unsigned int allowed = Allowed();
+        if (sum <= allowed) {
+            m_sum = sum;
+            return true;
+        }
+
+        // scale all channels by the same factor to preserve hue
+        red   = static_cast<unsigned char>(red * allowed / sum);
+        green = static_cast<unsigned char>(green * allowed / sum);
+        blue  = static_cast<unsigned char>(blue * allowed / sum);
+        m_sum = red + green + blue;
+        return false;
+    }
+
+    /** Average R+G+B sum over the time window. */
+    unsigned int Average() const {
+        return static_cast<unsigned int>(m_avg >> FRAC_BITS);
+    }
+
+private:
+    static constexpr unsigned int FRAC_BITS = 16; // Q16 fixed-point
+
+    void Integrate(unsigned long long now) {
+        unsigned long long dt = (now > m_time) ? now - m_time : 0;
+        m_time = now;
+        if (dt > 64 * WINDOW)
+            dt = 64 * WINDOW; // avoid overflow (average has fully converged anyway)
+
+        // alpha = dt/(dt+WINDOW) approximates 1-exp(-dt/WINDOW) for any step length
+        long long alpha = static_cast<long long>((dt << FRAC_BITS) / (dt + WINDOW));
+        long long target = static_cast<long long>(m_sum) << FRAC_BITS;
+        m_avg += (target - m_avg) * alpha / (1 << FRAC_BITS);
+    }
+
+    /** Allowed R+G+B sum for the next frame.
+        Ramps linearly from PEAK_LIMIT at zero average down to SUSTAINED_LIMIT
+        when the average reaches SUSTAINED_LIMIT, so that a continuously bright
+        stream converges on SUSTAINED_LIMIT without abrupt steps. */
+    unsigned int Allowed() const {
+        const long long sustained = static_cast<long long>(SUSTAINED_LIMIT) << FRAC_BITS;
+        if (m_avg >= sustained)
+            return SUSTAINED_LIMIT;
+
+        return PEAK_LIMIT - static_cast<unsigned int>((PEAK_LIMIT - SUSTAINED_LIMIT) * m_avg / sustained);
+    }
+
+    long long          m_avg = 0;  // EMA of R+G+B sum (Q16)
+    unsigned long long m_time = 0; // timestamp of last frame
+    unsigned int       m_sum = 0;  // R+G+B sum of last frame
+};
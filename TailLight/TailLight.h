@@ -31,22 +31,6 @@ struct TailLightReport {
     }
 #endif
 
-#ifdef _KERNEL_MODE
-    bool SafetyCheck() {
-        // RGB check
-        unsigned int color_sum = Red + Green + Blue;
-        if (color_sum > 640) {
-            KdPrint(("TailLight: Color saturation %u exceeded 640 threshold. Reseting color to RED to signal error\n", color_sum));
-            Red = 255;
-            Green = 0;
-            Blue = 0;
-            return false;
-        }
-
-        return true;
-    }
-#endif
-
     //report ID of the collection to which the control request is sent
     UCHAR   ReportId = 36; // (0x24)
 
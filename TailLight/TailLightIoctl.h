@@ -0,0 +1,45 @@
+#pragma once
+/** Public interface of the TailLight driver IOCTL fast path.
+    Shared between the driver and user-mode clients. User-mode clients must include
+    <windows.h> and <winioctl.h> first, and <initguid.h> in one translation unit. */
+
+/** Device interface exposed by the TailLight filter for each tail-light collection. */
+// {5C1A3F4E-6D2B-4B8E-9A51-2E7C0D94B3A6}
+DEFINE_GUID(GUID_DEVINTERFACE_TAILLIGHT, 0x5c1a3f4e, 0x6d2b, 0x4b8e, 0x9a, 0x51, 0x2e, 0x7c, 0x0d, 0x94, 0xb3, 0xa6);
+
+/** Device type for TailLight IOCTLs (values below 0x8000 are reserved by Microsoft). */
+#define FILE_DEVICE_TAILLIGHT 0x8A24
+
+/** Set color. Input: TAILLIGHT_COLOR. Stops any batch playback. */
+#define IOCTL_TAILLIGHT_SET_COLOR    CTL_CODE(FILE_DEVICE_TAILLIGHT, 0x800, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+/** Get last written color. Output: TAILLIGHT_COLOR. */
+#define IOCTL_TAILLIGHT_GET_COLOR    CTL_CODE(FILE_DEVICE_TAILLIGHT, 0x801, METHOD_BUFFERED, FILE_READ_ACCESS)
+/** Upload a color sequence that the driver plays on a timer. Input: TAILLIGHT_BATCH followed by Count entries.
+    Replaces any batch being played. An empty batch stops playback. */
+#define IOCTL_TAILLIGHT_UPLOAD_BATCH CTL_CODE(FILE_DEVICE_TAILLIGHT, 0x802, METHOD_BUFFERED, FILE_WRITE_ACCESS)
+
+/** Color in COLORREF format (0x00BBGGRR). Colors with the upper byte set are rejected. */
+struct TAILLIGHT_COLOR {
+    ULONG Color;
+};
+
+/** Color to show for a given duration. */
+struct TAILLIGHT_BATCH_ENTRY {
+    ULONG Color;
+    ULONG DurationMs; // [1, TAILLIGHT_BATCH_MAX_DURATION_MS]
+};
+
+/** Max number of entries in a batch. */
+static constexpr ULONG TAILLIGHT_BATCH_MAX_ENTRIES = 64;
+/** Max duration of a single batch entry. */
+static constexpr ULONG TAILLIGHT_BATCH_MAX_DURATION_MS = 60 * 1000;
+
+/** TAILLIGHT_BATCH flags. */
+static constexpr ULONG TAILLIGHT_BATCH_LOOP = 0x1; // restart from the first entry after the last
+
+/** Batch upload header, followed by "Count" TAILLIGHT_BATCH_ENTRY elements. */
+struct TAILLIGHT_BATCH {
+    ULONG Count;
+    ULONG Flags;
+    TAILLIGHT_BATCH_ENTRY Entries[1];
+};
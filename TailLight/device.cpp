@@ -124,6 +124,35 @@ Arguments:
         KdPrint(("TailLight: PdoName: %wZ\n", deviceContext->PdoName)); // outputs "\Device\00000083"
     }
 
+    {
+        // create lock for serializing power budget and safety log updates
+        WDF_OBJECT_ATTRIBUTES attributes = {};
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = device; // auto-delete with device
+
+        NTSTATUS status = WdfSpinLockCreate(&attributes, &deviceContext->SafetyLock);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("TailLight: WdfSpinLockCreate failed 0x%x\n", status));
+            return status;
+        }
+    }
+
+    {
+        // create timer for flushing rate-limited safety events
+        WDF_TIMER_CONFIG timerCfg = {};
+        WDF_TIMER_CONFIG_INIT(&timerCfg, SafetyLogTimerProc);
+
+        WDF_OBJECT_ATTRIBUTES attribs = {};
+        WDF_OBJECT_ATTRIBUTES_INIT(&attribs);
+        attribs.ParentObject = device; // auto-delete with device
+
+        NTSTATUS status = WdfTimerCreate(&timerCfg, &attribs, &deviceContext->SafetyLogTimer);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("TailLight: WdfTimerCreate failed 0x%x\n", status));
+            return status;
+        }
+    }
+
     {
         // create queue for filtering
         WDF_IO_QUEUE_CONFIG queueConfig = {};
@@ -148,6 +177,13 @@ Arguments:
         return status;
     }
 
+    // Initialize IOCTL interface
+    status = IoctlInitialize(device);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: Error initializing IOCTL interface 0x%x\n", status));
+        return status;
+    }
+
     return status;
 }
 
@@ -180,12 +216,16 @@ Arguments:
     IoControlCode - The driver or system defined IOCTL associated with the request
 --*/
 {
-    UNREFERENCED_PARAMETER(OutputBufferLength);
-
     //KdPrint(("TailLight: EvtIoDeviceControl (IoControlCode=0x%x, InputBufferLength=%Iu)\n", IoControlCode, InputBufferLength));
 
     WDFDEVICE device = WdfIoQueueGetDevice(Queue);
 
+    if (IsTailLightIoctl(IoControlCode)) {
+        // handled by this driver, so don't forward
+        TailLightIoctl(device, Request, OutputBufferLength, InputBufferLength, IoControlCode);
+        return;
+    }
+
     NTSTATUS status = STATUS_SUCCESS; //unhandled
     switch (IoControlCode) {
       case IOCTL_HID_SET_FEATURE: // 0xb0191
@@ -1,10 +1,32 @@
 #pragma once
+#include "PowerBudget.hpp"
+#include "LogLimiter.hpp"
+#include "telemetry.h"
 
 /** Driver-specific struct for storing instance-specific data. */
 struct DEVICE_CONTEXT {
     UNICODE_STRING PdoName;
     WDFWMIINSTANCE WmiInstance;
     WDFTIMER       SelfTestTimer;
+    WDFSPINLOCK    SafetyLock;     // protects Power and SafetyLog
+    PowerBudget    Power;          // sustained brightness limiter
+    LogLimiter     SafetyLog;      // rate limiter for safety event logging
+    WDFTIMER       SafetyLogTimer; // flushes aggregated safety events
+    FEATURE_TELEMETRY Telemetry;   // SetFeatureColor latency and error statistics
+    ULONG          LastColor;      // last color written to device
+
+    WDFWMIINSTANCE ColorEventInstance; // TailLightColorChanged event
+    WDFTIMER       ColorEventTimer;    // coalesces color change events
+    volatile LONG  ColorEventPending;  // event scheduled but not yet fired
+    ULONGLONG      ColorEventTime;     // time of last fired event
+
+    WDFTIMER       BatchTimer;      // plays uploaded color sequence
+    WDFSPINLOCK    BatchLock;       // protects Batch* fields
+    TAILLIGHT_BATCH_ENTRY BatchEntries[TAILLIGHT_BATCH_MAX_ENTRIES];
+    ULONG          BatchCount;      // 0 if no batch is played
+    ULONG          BatchIndex;      // next entry to play
+    ULONG          BatchFlags;      // TAILLIGHT_BATCH_Xxx
+    ULONG          BatchGeneration; // incremented when the batch is replaced or stopped
 };
 WDF_DECLARE_CONTEXT_TYPE(DEVICE_CONTEXT)
 
@@ -1,4 +1,5 @@
 #include "driver.h"
+#include "PoolAllocator.hpp"
 
 /** Driver entry point.
     Initialize the framework and register driver event handlers. */
@@ -9,6 +10,10 @@ NTSTATUS DriverEntry(
 {
     KdPrint(("TailLight: DriverEntry - WDF version built on %s %s\n", __DATE__, __TIME__));
 
+    // Initialize lookaside lists for C++ allocations
+    if (!PoolInitialize())
+        return STATUS_INSUFFICIENT_RESOURCES;
+
     WDF_DRIVER_CONFIG params = {};
     WDF_DRIVER_CONFIG_INIT(/*out*/&params, EvtDriverDeviceAdd);
     params.DriverPoolTag = POOL_TAG;
@@ -23,6 +28,7 @@ NTSTATUS DriverEntry(
     if (!NT_SUCCESS(status)) {
         // Framework will automatically cleanup on error Status return
         KdPrint(("TailLight: Error Creating WDFDRIVER 0x%x\n", status));
+        PoolCleanup();
     }
 
     return status;
@@ -37,4 +43,6 @@ VOID EvtDriverUnload(
 {
     UNREFERENCED_PARAMETER(Driver);
     KdPrint(("TailLight: DriverUnload.\n"));
+
+    PoolCleanup();
 }
@@ -7,10 +7,12 @@
 
 // Generated WMI class definitions (from TailLight.mof)
 #include "TailLightmof.h"
+#include "TailLightIoctl.h"
 
 #include "device.h"
 #include "wmi.h"
 #include "vfeature.h"
+#include "ioctl.h"
 
 
 /** Memory allocation tag name (for debugging leaks). */
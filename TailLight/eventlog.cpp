@@ -8,17 +8,19 @@ constexpr USHORT IO_ERROR_LOG_PACKET_size() {
 }
 
 
-void WriteToSystemLog(WDFDEVICE Device, NTSTATUS MessageId, WCHAR* InsertionStr1, WCHAR* InsertionStr2) {
-    // determine length of each insertion string
-    UCHAR InsertionStr1Len = 0;
-    if (InsertionStr1)
-        InsertionStr1Len = sizeof(WCHAR)*(UCHAR)(wcslen(InsertionStr1)+1); // in bytes (incl. null-termination)
-    UCHAR InsertionStr2Len = 0;
-    if (InsertionStr2)
-        InsertionStr2Len = sizeof(WCHAR)*(UCHAR)(wcslen(InsertionStr2)+1); // in bytes (incl. null-termination)
+void WriteToSystemLog(WDFDEVICE Device, NTSTATUS MessageId, WCHAR* InsertionStr1, WCHAR* InsertionStr2, WCHAR* InsertionStr3, WCHAR* InsertionStr4) {
+    WCHAR* InsertionStrs[] = {InsertionStr1, InsertionStr2, InsertionStr3, InsertionStr4};
 
+    // determine length of each insertion string
+    UCHAR InsertionStrsLen[ARRAYSIZE(InsertionStrs)] = {};
+    USHORT strings_size = 0;
+    for (size_t i = 0; i < ARRAYSIZE(InsertionStrs); i++) {
+        if (InsertionStrs[i])
+            InsertionStrsLen[i] = sizeof(WCHAR)*(UCHAR)(wcslen(InsertionStrs[i])+1); // in bytes (incl. null-termination)
+        strings_size += InsertionStrsLen[i];
+    }
 
-    USHORT total_size = IO_ERROR_LOG_PACKET_size() + InsertionStr1Len + InsertionStr2Len;
+    USHORT total_size = IO_ERROR_LOG_PACKET_size() + strings_size;
     if (total_size > ERROR_LOG_MAXIMUM_SIZE) {
         // overflow check
         KdPrint(("TailLight: IoAllocateErrorLogEntry too long message.\n"));
@@ -37,10 +39,10 @@ void WriteToSystemLog(WDFDEVICE Device, NTSTATUS MessageId, WCHAR* InsertionStr1
     entry->RetryCount = 0;
     entry->DumpDataSize = 0;
     entry->NumberOfStrings = 0;
-    if (InsertionStr1Len)
-        entry->NumberOfStrings++;
-    if (InsertionStr2Len)
-        entry->NumberOfStrings++;
+    for (size_t i = 0; i < ARRAYSIZE(InsertionStrs); i++) {
+        if (InsertionStrsLen[i])
+            entry->NumberOfStrings++;
+    }
     entry->StringOffset = IO_ERROR_LOG_PACKET_size(); // insertion string offsets
     entry->EventCategory = 0;    // TBD
     entry->ErrorCode = MessageId;
@@ -51,13 +53,11 @@ void WriteToSystemLog(WDFDEVICE Device, NTSTATUS MessageId, WCHAR* InsertionStr1
     entry->DeviceOffset.QuadPart = 0; // offset in device where error occured (optional)
 
     BYTE* dest = (BYTE*)entry + entry->StringOffset;
-    if (InsertionStr1Len) {
-        RtlCopyMemory(/*dst*/dest, /*src*/InsertionStr1, InsertionStr1Len);
-        dest += InsertionStr1Len;
-    }
-    if (InsertionStr2Len) {
-        RtlCopyMemory(/*dst*/dest, /*src*/InsertionStr2, InsertionStr2Len);
-        dest += InsertionStr2Len;
+    for (size_t i = 0; i < ARRAYSIZE(InsertionStrs); i++) {
+        if (InsertionStrsLen[i]) {
+            RtlCopyMemory(/*dst*/dest, /*src*/InsertionStrs[i], InsertionStrsLen[i]);
+            dest += InsertionStrsLen[i];
+        }
     }
 
     // Write to windows system log.
@@ -5,5 +5,5 @@
 
 
 /** Write to the Windows Event Viewer "System" log.
-    InsertionStr1 is a null-terminated string. */
-void WriteToSystemLog(WDFDEVICE Device, NTSTATUS MessageId, WCHAR* InsertionStr1, WCHAR* InsertionStr2);
+    Insertion strings are null-terminated strings or nullptr. */
+void WriteToSystemLog(WDFDEVICE Device, NTSTATUS MessageId, WCHAR* InsertionStr1, WCHAR* InsertionStr2, WCHAR* InsertionStr3 = nullptr, WCHAR* InsertionStr4 = nullptr);
@@ -0,0 +1,192 @@
+#include "driver.h"
+
+
+void StopBatch(DEVICE_CONTEXT* deviceContext) {
+    WdfSpinLockAcquire(deviceContext->BatchLock);
+    deviceContext->BatchCount = 0;
+    deviceContext->BatchIndex = 0;
+    deviceContext->BatchGeneration++;
+    WdfSpinLockRelease(deviceContext->BatchLock);
+
+    // wait for an in-progress batch write, so that it can't overwrite the caller's color afterwards
+    WdfTimerStop(deviceContext->BatchTimer, TRUE);
+}
+
+
+VOID BatchTimerProc(_In_ WDFTIMER Timer) {
+    WDFDEVICE device = (WDFDEVICE)WdfTimerGetParentObject(Timer);
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(device);
+
+    // pick next entry
+    WdfSpinLockAcquire(deviceContext->BatchLock);
+    if ((deviceContext->BatchIndex >= deviceContext->BatchCount) && (deviceContext->BatchFlags & TAILLIGHT_BATCH_LOOP))
+        deviceContext->BatchIndex = 0;
+    if (deviceContext->BatchIndex >= deviceContext->BatchCount) {
+        WdfSpinLockRelease(deviceContext->BatchLock);
+        return; // playback completed or stopped
+    }
+    TAILLIGHT_BATCH_ENTRY entry = deviceContext->BatchEntries[deviceContext->BatchIndex++];
+    ULONG generation = deviceContext->BatchGeneration;
+    WdfSpinLockRelease(deviceContext->BatchLock);
+
+    // colors were validated on upload
+    ULONGLONG start = KeQueryInterruptTime();
+    NTSTATUS status = SetFeatureColor(device, entry.Color);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: %s: SetFeatureColor failed 0x%x\n", __func__, status));
+    }
+
+    // show entry for its duration, including the time spent writing it
+    ULONGLONG elapsed = KeQueryInterruptTime() - start;
+    ULONGLONG duration = WDF_ABS_TIMEOUT_IN_MS(entry.DurationMs);
+    LONGLONG delay = (duration > elapsed) ? (LONGLONG)(duration - elapsed) : 0;
+
+    WdfSpinLockAcquire(deviceContext->BatchLock);
+    if (generation == deviceContext->BatchGeneration)
+        WdfTimerStart(Timer, -delay); // relative time (not replaced or stopped in the meantime)
+    WdfSpinLockRelease(deviceContext->BatchLock);
+}
+
+
+static NTSTATUS SetColorIoctl(WDFDEVICE Device, WDFREQUEST Request) {
+    TAILLIGHT_COLOR* input = nullptr;
+    NTSTATUS status = WdfRequestRetrieveInputBuffer(Request, sizeof(TAILLIGHT_COLOR), (void**)&input, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: WdfRequestRetrieveInputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    StopBatch(WdfObjectGet_DEVICE_CONTEXT(Device));
+
+    // same validation and power budget as the WMI interface
+    return ApplyColor(Device, input->Color);
+}
+
+
+static NTSTATUS GetColorIoctl(WDFDEVICE Device, WDFREQUEST Request, size_t* bytesReturned) {
+    TAILLIGHT_COLOR* output = nullptr;
+    NTSTATUS status = WdfRequestRetrieveOutputBuffer(Request, sizeof(TAILLIGHT_COLOR), (void**)&output, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: WdfRequestRetrieveOutputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    // last written color, as reported through WMI
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+    output->Color = WdfObjectGet_TailLightDeviceInformation(deviceContext->WmiInstance)->TailLight;
+    *bytesReturned = sizeof(TAILLIGHT_COLOR);
+    return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS UploadBatchIoctl(WDFDEVICE Device, WDFREQUEST Request, size_t InputBufferLength) {
+    const size_t headerSize = FIELD_OFFSET(TAILLIGHT_BATCH, Entries);
+
+    TAILLIGHT_BATCH* batch = nullptr;
+    NTSTATUS status = WdfRequestRetrieveInputBuffer(Request, headerSize, (void**)&batch, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: WdfRequestRetrieveInputBuffer failed 0x%x\n", status));
+        return status;
+    }
+
+    if (batch->Count > TAILLIGHT_BATCH_MAX_ENTRIES)
+        return STATUS_INVALID_PARAMETER;
+    if (InputBufferLength < headerSize + batch->Count * sizeof(TAILLIGHT_BATCH_ENTRY))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    // validate all entries before replacing the current batch
+    for (ULONG i = 0; i < batch->Count; i++) {
+        const TAILLIGHT_BATCH_ENTRY& entry = batch->Entries[i];
+        if (!IsValidColor(entry.Color) || (entry.DurationMs == 0) || (entry.DurationMs > TAILLIGHT_BATCH_MAX_DURATION_MS)) {
+            KdPrint(("TailLight: Invalid batch entry %u (Color=0x%x, DurationMs=%u)\n", i, entry.Color, entry.DurationMs));
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+    WdfSpinLockAcquire(deviceContext->BatchLock);
+    RtlCopyMemory(deviceContext->BatchEntries, batch->Entries, batch->Count * sizeof(TAILLIGHT_BATCH_ENTRY));
+    deviceContext->BatchCount = batch->Count;
+    deviceContext->BatchIndex = 0;
+    deviceContext->BatchFlags = batch->Flags;
+    deviceContext->BatchGeneration++;
+    if (batch->Count > 0)
+        WdfTimerStart(deviceContext->BatchTimer, 0); // start playback (replaces pending due time)
+    WdfSpinLockRelease(deviceContext->BatchLock);
+
+    KdPrint(("TailLight: Uploaded batch with %u entries\n", batch->Count));
+    return STATUS_SUCCESS;
+}
+
+
+void TailLightIoctl(
+    _In_ WDFDEVICE  Device,
+    _In_ WDFREQUEST Request,
+    _In_ size_t     OutputBufferLength,
+    _In_ size_t     InputBufferLength,
+    _In_ ULONG      IoControlCode
+)
+{
+    UNREFERENCED_PARAMETER(OutputBufferLength); // checked by WdfRequestRetrieveOutputBuffer
+
+    size_t bytesReturned = 0;
+    NTSTATUS status = STATUS_INVALID_DEVICE_REQUEST;
+    switch (IoControlCode) {
+    case IOCTL_TAILLIGHT_SET_COLOR:
+        status = SetColorIoctl(Device, Request);
+        break;
+    case IOCTL_TAILLIGHT_GET_COLOR:
+        status = GetColorIoctl(Device, Request, &bytesReturned);
+        break;
+    case IOCTL_TAILLIGHT_UPLOAD_BATCH:
+        status = UploadBatchIoctl(Device, Request, InputBufferLength);
+        break;
+    }
+
+    WdfRequestCompleteWithInformation(Request, status, bytesReturned);
+}
+
+
+NTSTATUS IoctlInitialize(_In_ WDFDEVICE Device)
+{
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+
+    {
+        // create lock for batch state
+        WDF_OBJECT_ATTRIBUTES attributes = {};
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device; // auto-delete with device
+
+        NTSTATUS status = WdfSpinLockCreate(&attributes, &deviceContext->BatchLock);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("TailLight: WdfSpinLockCreate failed 0x%x\n", status));
+            return status;
+        }
+    }
+
+    {
+        // create batch playback timer
+        WDF_TIMER_CONFIG timerCfg = {};
+        WDF_TIMER_CONFIG_INIT(&timerCfg, BatchTimerProc);
+
+        WDF_OBJECT_ATTRIBUTES attribs = {};
+        WDF_OBJECT_ATTRIBUTES_INIT(&attribs);
+        attribs.ExecutionLevel = WdfExecutionLevelPassive; // required to access HID functions
+        attribs.ParentObject = Device;
+
+        NTSTATUS status = WdfTimerCreate(&timerCfg, &attribs, &deviceContext->BatchTimer);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("TailLight: %s: WdfTimerCreate failed 0x%x\n", __func__, status));
+            return status;
+        }
+    }
+
+    // expose interface for IOCTL_TAILLIGHT_Xxx requests
+    NTSTATUS status = WdfDeviceCreateDeviceInterface(Device, &GUID_DEVINTERFACE_TAILLIGHT, NULL);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: WdfDeviceCreateDeviceInterface failed 0x%x\n", status));
+        return status;
+    }
+
+    return status;
+}
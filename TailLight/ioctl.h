@@ -0,0 +1,25 @@
+#pragma once
+
+/** Create the TailLight device interface and the batch playback timer.
+    Must be called after WmiInitialize. */
+NTSTATUS IoctlInitialize(_In_ WDFDEVICE Device);
+
+/** Returns true for IOCTL_TAILLIGHT_Xxx codes. */
+inline bool IsTailLightIoctl(ULONG IoControlCode) {
+    return DEVICE_TYPE_FROM_CTL_CODE(IoControlCode) == FILE_DEVICE_TAILLIGHT;
+}
+
+/** Handle IOCTL_TAILLIGHT_Xxx requests. Completes the request. */
+void TailLightIoctl(
+    _In_ WDFDEVICE  Device,
+    _In_ WDFREQUEST Request,
+    _In_ size_t     OutputBufferLength,
+    _In_ size_t     InputBufferLength,
+    _In_ ULONG      IoControlCode
+);
+
+/** Stop batch playback, so that a color set through another interface isn't overwritten by the next batch entry.
+    Waits for a timer callback already in progress, which will not reschedule itself. Must be called at PASSIVE_LEVEL. */
+void StopBatch(DEVICE_CONTEXT* deviceContext);
+
+EVT_WDF_TIMER BatchTimerProc;
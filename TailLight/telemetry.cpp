@@ -0,0 +1,27 @@
+#include "driver.h"
+
+
+void FEATURE_TELEMETRY::RecordLatency(TELEMETRY_PHASE phase, LARGE_INTEGER start) {
+    LARGE_INTEGER freq = {};
+    LARGE_INTEGER now = KeQueryPerformanceCounter(&freq);
+    ULONGLONG us = (ULONGLONG)(now.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart;
+
+    ULONG bucket = 0;
+    while ((bucket < LATENCY_BUCKETS - 1) && (us >= LATENCY_BUCKET_LIMITS_US[bucket]))
+        bucket++;
+
+    InterlockedIncrement(&Latency[phase][bucket]);
+}
+
+void FEATURE_TELEMETRY::RecordError(NTSTATUS status) {
+    for (ULONG i = 0; i < ERROR_SLOTS; i++) {
+        // claim slot if unused
+        LONG prev = InterlockedCompareExchange(&ErrorStatus[i], status, 0);
+        if ((prev == 0) || (prev == status)) {
+            InterlockedIncrement(&ErrorCount[i]);
+            return;
+        }
+    }
+
+    InterlockedIncrement(&ErrorOther);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/** SetFeatureColor phases with separate latency histograms. */
+enum TELEMETRY_PHASE {
+    PhaseOpen,       // I/O target creation and open
+    PhaseCaps,       // collection information, descriptor and caps query
+    PhaseSetFeature, // IOCTL_HID_SET_FEATURE
+    PhaseCount
+};
+
+static constexpr ULONG LATENCY_BUCKETS = 8;
+static constexpr ULONG ERROR_SLOTS = 8;
+
+/** Upper latency bound in microseconds for each histogram bucket (0 means unbounded). */
+static constexpr ULONG LATENCY_BUCKET_LIMITS_US[LATENCY_BUCKETS] = {100, 250, 500, 1000, 2500, 5000, 10000, 0};
+
+/** Per-device latency histograms and error counts for feature writes.
+    Updated with interlocked operations so that it can be shared without locking. */
+struct FEATURE_TELEMETRY {
+    volatile LONG Latency[PhaseCount][LATENCY_BUCKETS];
+    volatile LONG ErrorStatus[ERROR_SLOTS]; // NTSTATUS per slot (0 means unused)
+    volatile LONG ErrorCount[ERROR_SLOTS];
+    volatile LONG ErrorOther;               // errors that didn't fit in any slot
+
+    /** Record time elapsed since "start" (from KeQueryPerformanceCounter). */
+    void RecordLatency(TELEMETRY_PHASE phase, LARGE_INTEGER start);
+
+    /** Record a failure status. */
+    void RecordError(NTSTATUS status);
+};
@@ -27,6 +27,41 @@ private:
 };
 
 
+/** Write aggregated safety events to the Windows Event Viewer "System" log. */
+static void LogSafetySummary(WDFDEVICE Device, const LogLimiter::Summary& summary) {
+    WCHAR count[16] = {};
+    swprintf_s(count, L"%u", summary.Count);
+    WCHAR first_color[16] = {};
+    swprintf_s(first_color, L"%u,%u,%u", summary.FirstColor & 0xFF, (summary.FirstColor >> 8) & 0xFF, (summary.FirstColor >> 16) & 0xFF);
+    WCHAR last_color[16] = {};
+    swprintf_s(last_color, L"%u,%u,%u", summary.LastColor & 0xFF, (summary.LastColor >> 8) & 0xFF, (summary.LastColor >> 16) & 0xFF);
+    WCHAR saturation[16] = {};
+    swprintf_s(saturation, L"%u", summary.WorstSaturation);
+
+    WriteToSystemLog(Device, TailLight_SAFETY, count, first_color, last_color, saturation);
+}
+
+
+VOID SafetyLogTimerProc(_In_ WDFTIMER Timer) {
+    WDFDEVICE device = (WDFDEVICE)WdfTimerGetParentObject(Timer);
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(device);
+
+    ULONGLONG now = KeQueryInterruptTime();
+    LogLimiter::Summary summary = {};
+
+    WdfSpinLockAcquire(deviceContext->SafetyLock);
+    LogLimiter::Action action = deviceContext->SafetyLog.Flush(now);
+    if (action == LogLimiter::Emit)
+        summary = deviceContext->SafetyLog.Take();
+    else if (action == LogLimiter::Schedule)
+        WdfTimerStart(Timer, -(LONGLONG)deviceContext->SafetyLog.Delay(now)); // relative time
+    WdfSpinLockRelease(deviceContext->SafetyLock);
+
+    if (action == LogLimiter::Emit)
+        LogSafetySummary(device, summary);
+}
+
+
 NTSTATUS SetFeatureColor (
     _In_ WDFDEVICE Device,
     _In_ ULONG     Color
@@ -39,17 +74,22 @@ NTSTATUS SetFeatureColor (
 {
     KdPrint(("TailLight: SetFeatureColor\n"));
 
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+    FEATURE_TELEMETRY& telemetry = deviceContext->Telemetry;
+
     WDFIOTARGET_Wrap hidTarget;
     {
+        LARGE_INTEGER start = KeQueryPerformanceCounter(NULL);
+
         // open "hidTarget" using PdoName
         NTSTATUS status = WdfIoTargetCreate(Device, WDF_NO_OBJECT_ATTRIBUTES, &hidTarget);
         if (!NT_SUCCESS(status)) {
             KdPrint(("TailLight: WdfIoTargetCreate failed 0x%x\n", status));
+            telemetry.RecordError(status);
             return status;
         }
 
         // open in write-only mode
-        DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
         WDF_IO_TARGET_OPEN_PARAMS openParams = {};
         WDF_IO_TARGET_OPEN_PARAMS_INIT_OPEN_BY_NAME(&openParams, &deviceContext->PdoName, FILE_WRITE_ACCESS);
 
@@ -60,10 +100,15 @@ NTSTATUS SetFeatureColor (
         status = WdfIoTargetOpen(hidTarget, &openParams);
         if (!NT_SUCCESS(status)) {
             KdPrint(("TailLight: WdfIoTargetOpen failed 0x%x\n", status));
+            telemetry.RecordError(status);
             return status;
         }
+
+        telemetry.RecordLatency(PhaseOpen, start);
     }
 
+    LARGE_INTEGER capsStart = KeQueryPerformanceCounter(NULL);
+
     HID_COLLECTION_INFORMATION collectionInfo = {};
     {
         // populate "collectionInformation"
@@ -82,12 +127,14 @@ NTSTATUS SetFeatureColor (
 
         if (!NT_SUCCESS(status)) {
             KdPrint(("TailLight: WdfIoTargetSendIoctlSynchronously1 failed 0x%x\n", status));
+            telemetry.RecordError(status);
             return status;
         }
     }
 
     PHIDP_PREPARSED_DATA_Wrap preparsedData(collectionInfo.DescriptorSize);
     if (!preparsedData) {
+        telemetry.RecordError(STATUS_INSUFFICIENT_RESOURCES);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
@@ -106,6 +153,7 @@ NTSTATUS SetFeatureColor (
 
         if (!NT_SUCCESS(status)) {
             KdPrint(("TailLight: WdfIoTargetSendIoctlSynchronously2 failed 0x%x\n", status));
+            telemetry.RecordError(status);
             return status;
         }
     }
@@ -115,6 +163,7 @@ NTSTATUS SetFeatureColor (
         HIDP_CAPS caps = {};
         NTSTATUS status = HidP_GetCaps(preparsedData, &caps);
         if (!NT_SUCCESS(status)) {
+            telemetry.RecordError(status);
             return status;
         }
 
@@ -122,8 +171,11 @@ NTSTATUS SetFeatureColor (
 
         if (caps.FeatureReportByteLength != sizeof(TailLightReport)) {
             KdPrint(("TailLight: FeatureReportByteLength mismatch (%u, %Iu).\n", caps.FeatureReportByteLength, sizeof(TailLightReport)));
+            telemetry.RecordError(STATUS_DEVICE_CONFIGURATION_ERROR);
             return status;
         }
+
+        telemetry.RecordLatency(PhaseCaps, capsStart);
     }
 
     // Create a report to send to the device.
@@ -131,6 +183,8 @@ NTSTATUS SetFeatureColor (
     report.SetColor(Color);
 
     {
+        LARGE_INTEGER start = KeQueryPerformanceCounter(NULL);
+
         // send TailLightReport to device
         WDF_MEMORY_DESCRIPTOR reportDesc = {};
         WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(&reportDesc, &report, sizeof(report));
@@ -143,14 +197,33 @@ NTSTATUS SetFeatureColor (
             NULL);
         if (!NT_SUCCESS(status)) {
             KdPrint(("TailLight: WdfIoTargetSendIoctlSynchronously3 failed 0x%x\n", status));
+            telemetry.RecordError(status);
             return status;
         }
+
+        telemetry.RecordLatency(PhaseSetFeature, start);
     }
 
     return STATUS_SUCCESS;
 }
 
 
+NTSTATUS ApplyColor (
+    _In_ WDFDEVICE Device,
+    _In_ ULONG     Color
+    )
+{
+    if (!IsValidColor(Color)) {
+        KdPrint(("TailLight: ApplyColor: Invalid color 0x%x\n", Color));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    // SetFeatureColor sends the report through the device stack, so SetFeatureFilter
+    // enforces the power budget and updates the color reported through WMI
+    return SetFeatureColor(Device, Color);
+}
+
+
 NTSTATUS SetFeatureFilter(
     _In_ WDFDEVICE  Device,
     _In_ WDFREQUEST Request,
@@ -195,21 +268,42 @@ Arguments:
     UCHAR b = packet->Blue;
     KdPrint(("TailLight: Red=%u, Green=%u, Blue=%u\n", r, g, b));
 
-    // Enforce safety limits (sets color to RED on failure)
-    if (!packet->SafetyCheck()) {
+    // Enforce power budget (scales down color on failure)
+    ULONGLONG now = KeQueryInterruptTime();
+    LogLimiter::Action logAction = LogLimiter::None;
+    LogLimiter::Summary summary = {};
+
+    WdfSpinLockAcquire(deviceContext->SafetyLock);
+    bool withinBudget = deviceContext->Power.Apply(now, packet->Red, packet->Green, packet->Blue);
+    if (!withinBudget) {
+        // aggregate safety violations to avoid flooding the event log
+        logAction = deviceContext->SafetyLog.Record(now, (b << 16) | (g << 8) | r, r + g + b);
+        if (logAction == LogLimiter::Emit)
+            summary = deviceContext->SafetyLog.Take();
+        else if (logAction == LogLimiter::Schedule)
+            WdfTimerStart(deviceContext->SafetyLogTimer, -(LONGLONG)deviceContext->SafetyLog.Delay(now)); // relative time
+    }
+    WdfSpinLockRelease(deviceContext->SafetyLock);
+
+    if (!withinBudget) {
+        KdPrint(("TailLight: Power budget exceeded. Color reduced to Red=%u, Green=%u, Blue=%u\n", packet->Red, packet->Green, packet->Blue));
+
         // log safety violation to Windows Event Viewer "System" log
-        WCHAR color_requested[16] = {};
-        swprintf_s(color_requested, L"%u,%u,%u", r, g, b);
-        WCHAR color_adjusted[16] = {};
-        swprintf_s(color_adjusted, L"%u,%u,%u", packet->Red, packet->Green, packet->Blue);
+        if (logAction == LogLimiter::Emit)
+            LogSafetySummary(Device, summary);
 
-        WriteToSystemLog(Device, TailLight_SAFETY, color_requested, color_adjusted);
         status =  STATUS_CONTENT_BLOCKED;
     }
 
     // update last written color
     TailLightDeviceInformation* pInfo = WdfObjectGet_TailLightDeviceInformation(deviceContext->WmiInstance);
-    pInfo->TailLight = packet->GetColor();
+    ULONG color = packet->GetColor();
+    pInfo->TailLight = color;
+
+    if (deviceContext->LastColor != color) {
+        deviceContext->LastColor = color;
+        WmiNotifyColorChanged(Device);
+    }
 
     return status;
 }
@@ -31,6 +31,20 @@ NTSTATUS SetFeatureColor (
     _In_  ULONG     Color
     );
 
+/** Returns true if "Color" is in COLORREF format (upper byte zero). */
+inline bool IsValidColor(ULONG Color) {
+    return (Color & 0xFF000000) == 0;
+}
+
+/** Validate and set color. Shared by the WMI and IOCTL interfaces, so that both are subject to
+    the same checks and to the power budget enforced by SetFeatureFilter. */
+NTSTATUS ApplyColor (
+    _In_  WDFDEVICE Device,
+    _In_  ULONG     Color
+    );
+
+EVT_WDF_TIMER SafetyLogTimerProc;
+
 NTSTATUS SetFeatureFilter(
     _In_ WDFDEVICE  Device,
     _In_ WDFREQUEST Request,
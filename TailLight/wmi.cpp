@@ -1,4 +1,5 @@
 #include "driver.h"
+#include "PoolAllocator.hpp"
 #include <stdlib.h>
 
 
@@ -69,6 +70,120 @@ static NTSTATUS EvtWmiInstanceExecuteMethod(
 }
 
 
+static NTSTATUS EvtWmiPoolStatisticsQueryInstance(
+    _In_  WDFWMIINSTANCE WmiInstance,
+    _In_  ULONG OutBufferSize,
+    _Out_writes_bytes_to_(OutBufferSize, *BufferUsed)  PVOID OutBuffer,
+    _Out_ PULONG BufferUsed
+    )
+{
+    UNREFERENCED_PARAMETER(WmiInstance); // same driver-global values for all instances
+    UNREFERENCED_PARAMETER(OutBufferSize); // mininum buffer size already checked by WDF
+
+    PoolClassStatistics stats[POOL_CLASS_COUNT] = {};
+    PoolGetStatistics(stats);
+
+    auto* pInfo = (TailLightPoolStatistics*)OutBuffer;
+    static_assert(ARRAYSIZE(pInfo->Tag) == POOL_CLASS_COUNT, "TailLightPoolStatistics array size mismatch");
+    for (unsigned int i = 0; i < POOL_CLASS_COUNT; i++) {
+        pInfo->Tag[i] = stats[i].Tag;
+        pInfo->BlockSize[i] = stats[i].BlockSize;
+        pInfo->Allocations[i] = stats[i].Allocations;
+        pInfo->Outstanding[i] = stats[i].Outstanding;
+        pInfo->HighWater[i] = stats[i].HighWater;
+        pInfo->Failures[i] = stats[i].Failures;
+    }
+    *BufferUsed = sizeof(*pInfo);
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS EvtWmiFeatureStatisticsQueryInstance(
+    _In_  WDFWMIINSTANCE WmiInstance,
+    _In_  ULONG OutBufferSize,
+    _Out_writes_bytes_to_(OutBufferSize, *BufferUsed)  PVOID OutBuffer,
+    _Out_ PULONG BufferUsed
+    )
+{
+    UNREFERENCED_PARAMETER(OutBufferSize); // mininum buffer size already checked by WDF
+
+    const FEATURE_TELEMETRY& telemetry = WdfObjectGet_DEVICE_CONTEXT(WdfWmiInstanceGetDevice(WmiInstance))->Telemetry;
+
+    auto* pInfo = (TailLightFeatureStatistics*)OutBuffer;
+    static_assert(ARRAYSIZE(pInfo->BucketLimit) == LATENCY_BUCKETS, "TailLightFeatureStatistics array size mismatch");
+    static_assert(ARRAYSIZE(pInfo->ErrorStatus) == ERROR_SLOTS, "TailLightFeatureStatistics array size mismatch");
+    for (ULONG i = 0; i < LATENCY_BUCKETS; i++) {
+        pInfo->BucketLimit[i] = LATENCY_BUCKET_LIMITS_US[i];
+        pInfo->OpenLatency[i] = telemetry.Latency[PhaseOpen][i];
+        pInfo->CapsLatency[i] = telemetry.Latency[PhaseCaps][i];
+        pInfo->SetFeatureLatency[i] = telemetry.Latency[PhaseSetFeature][i];
+    }
+    for (ULONG i = 0; i < ERROR_SLOTS; i++) {
+        pInfo->ErrorStatus[i] = telemetry.ErrorStatus[i];
+        pInfo->ErrorCount[i] = telemetry.ErrorCount[i];
+    }
+    pInfo->ErrorOther = telemetry.ErrorOther;
+    *BufferUsed = sizeof(*pInfo);
+
+    return STATUS_SUCCESS;
+}
+
+/** Fire TailLightColorChanged event with the current color. */
+VOID ColorEventTimerProc(_In_ WDFTIMER Timer) {
+    WDFDEVICE device = (WDFDEVICE)WdfTimerGetParentObject(Timer);
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(device);
+    TailLightDeviceInformation* pInfo = WdfObjectGet_TailLightDeviceInformation(deviceContext->WmiInstance);
+
+    // clear pending flag before reading the color, so that later changes schedule a new event
+    deviceContext->ColorEventTime = KeQueryInterruptTime();
+    InterlockedExchange(&deviceContext->ColorEventPending, FALSE);
+
+    TailLightColorChanged event = {};
+    event.TailLight = pInfo->TailLight;
+
+    NTSTATUS status = WdfWmiInstanceFireEvent(deviceContext->ColorEventInstance, sizeof(event), &event);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: WdfWmiInstanceFireEvent failed 0x%x\n", status));
+    }
+}
+
+void WmiNotifyColorChanged(_In_ WDFDEVICE Device) {
+    DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
+
+    if (InterlockedExchange(&deviceContext->ColorEventPending, TRUE))
+        return; // coalesce with already scheduled event
+
+    // delay event until EventInterval has passed since the last event
+    TailLightDeviceInformation* pInfo = WdfObjectGet_TailLightDeviceInformation(deviceContext->WmiInstance);
+    ULONGLONG due = deviceContext->ColorEventTime + WDF_ABS_TIMEOUT_IN_MS(pInfo->EventInterval);
+    ULONGLONG now = KeQueryInterruptTime();
+    LONGLONG delay = (due > now) ? (LONGLONG)(due - now) : 0;
+
+    WdfTimerStart(deviceContext->ColorEventTimer, -delay); // relative time
+}
+
+/** Register read-only datablock with a given query callback. */
+static NTSTATUS WmiInitializeStatistics(_In_ WDFDEVICE Device, const GUID& Guid, ULONG InstanceSize, PFN_WDF_WMI_INSTANCE_QUERY_INSTANCE EvtQueryInstance)
+{
+    WDF_WMI_PROVIDER_CONFIG providerConfig = {};
+    WDF_WMI_PROVIDER_CONFIG_INIT(&providerConfig, &Guid);
+    providerConfig.MinInstanceBufferSize = InstanceSize;
+
+    WDF_WMI_INSTANCE_CONFIG instanceConfig = {};
+    WDF_WMI_INSTANCE_CONFIG_INIT_PROVIDER_CONFIG(&instanceConfig, &providerConfig);
+    instanceConfig.Register = TRUE;
+    instanceConfig.EvtWmiInstanceQueryInstance = EvtQueryInstance;
+
+    NTSTATUS status = WdfWmiInstanceCreate(Device, &instanceConfig, WDF_NO_OBJECT_ATTRIBUTES, WDF_NO_HANDLE);
+    if (!NT_SUCCESS(status)) {
+        KdPrint(("TailLight: WdfWmiInstanceCreate error %x\n", status));
+        return status;
+    }
+
+    return status;
+}
+
+
 // Register our GUID and Datablock generated from the TailLight.mof file.
 NTSTATUS WmiInitialize(_In_ WDFDEVICE Device)
 {
@@ -105,6 +220,50 @@ NTSTATUS WmiInitialize(_In_ WDFDEVICE Device)
     DEVICE_CONTEXT* deviceContext = WdfObjectGet_DEVICE_CONTEXT(Device);
     deviceContext->WmiInstance = WmiInstance;
 
+    TailLightDeviceInformation* pInfo = WdfObjectGet_TailLightDeviceInformation(WmiInstance);
+    pInfo->EventInterval = DEFAULT_EVENT_INTERVAL;
+
+    {
+        // Register color changed event
+        WDF_WMI_PROVIDER_CONFIG eventProviderConfig = {};
+        WDF_WMI_PROVIDER_CONFIG_INIT(&eventProviderConfig, &TailLightColorChanged_GUID);
+        eventProviderConfig.Flags = WdfWmiProviderEventOnly;
+
+        WDF_WMI_INSTANCE_CONFIG eventInstanceConfig = {};
+        WDF_WMI_INSTANCE_CONFIG_INIT_PROVIDER_CONFIG(&eventInstanceConfig, &eventProviderConfig);
+        eventInstanceConfig.Register = TRUE;
+
+        status = WdfWmiInstanceCreate(Device, &eventInstanceConfig, WDF_NO_OBJECT_ATTRIBUTES, &deviceContext->ColorEventInstance);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("TailLight: WdfWmiInstanceCreate error %x\n", status));
+            return status;
+        }
+
+        // Initialize event coalescing timer
+        WDF_TIMER_CONFIG timerCfg = {};
+        WDF_TIMER_CONFIG_INIT(&timerCfg, ColorEventTimerProc);
+
+        WDF_OBJECT_ATTRIBUTES attribs = {};
+        WDF_OBJECT_ATTRIBUTES_INIT(&attribs);
+        attribs.ExecutionLevel = WdfExecutionLevelPassive; // required by WdfWmiInstanceFireEvent
+        attribs.ParentObject = Device;
+
+        status = WdfTimerCreate(&timerCfg, &attribs, &deviceContext->ColorEventTimer);
+        if (!NT_SUCCESS(status)) {
+            KdPrint(("TailLight: %s: WdfTimerCreate failed 0x%x\n", __func__, status));
+            return status;
+        }
+    }
+
+    // pool counters are driver-global, so all devices report the same values (labeled as such in the MOF)
+    status = WmiInitializeStatistics(Device, TailLightPoolStatistics_GUID, sizeof(TailLightPoolStatistics), EvtWmiPoolStatisticsQueryInstance);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    status = WmiInitializeStatistics(Device, TailLightFeatureStatistics_GUID, sizeof(TailLightFeatureStatistics), EvtWmiFeatureStatisticsQueryInstance);
+    if (!NT_SUCCESS(status))
+        return status;
+
     {
         // Initialize self-test timer
         WDF_TIMER_CONFIG timerCfg = {};
@@ -155,11 +314,14 @@ NTSTATUS EvtWmiInstanceSetInstance(
 
     KdPrint(("TailLight: WMI SetInstance\n"));
 
-    TailLightDeviceInformation* pInfo = WdfObjectGet_TailLightDeviceInformation(WmiInstance);
-    RtlCopyMemory(/*dst*/pInfo, /*src*/InBuffer, sizeof(*pInfo));
+    // only the color is applied. EventInterval is changed through SetItem, since clients
+    // writing back a cached instance would otherwise revert interval changes made meanwhile
+    const TailLightDeviceInformation* input = (const TailLightDeviceInformation*)InBuffer;
 
-    // call SetFeatureColor to trigger tail-light update
-    NTSTATUS status = SetFeatureColor(WdfWmiInstanceGetDevice(WmiInstance), pInfo->TailLight);
+    // trigger tail-light update (TailLight field is updated by SetFeatureFilter)
+    WDFDEVICE device = WdfWmiInstanceGetDevice(WmiInstance);
+    StopBatch(WdfObjectGet_DEVICE_CONTEXT(device));
+    NTSTATUS status = ApplyColor(device, input->TailLight);
 
     KdPrint(("TailLight: WMI SetInstance completed\n"));
     return status;
@@ -181,10 +343,15 @@ NTSTATUS EvtWmiInstanceSetItem(
         if (InBufferSize < TailLightDeviceInformation_TailLight_SIZE)
             return STATUS_BUFFER_TOO_SMALL;
 
-        pInfo->TailLight = *(ULONG*)InBuffer;
+        // trigger tail-light update (TailLight field is updated by SetFeatureFilter)
+        WDFDEVICE device = WdfWmiInstanceGetDevice(WmiInstance);
+        StopBatch(WdfObjectGet_DEVICE_CONTEXT(device));
+        status = ApplyColor(device, *(ULONG*)InBuffer);
+    } else if (DataItemId == TailLightDeviceInformation_EventInterval_ID) {
+        if (InBufferSize < TailLightDeviceInformation_EventInterval_SIZE)
+            return STATUS_BUFFER_TOO_SMALL;
 
-        // call SetFeatureColor to trigger tail-light update
-        status = SetFeatureColor(WdfWmiInstanceGetDevice(WmiInstance), pInfo->TailLight);
+        pInfo->EventInterval = *(ULONG*)InBuffer;
     } else {
         return STATUS_INVALID_DEVICE_REQUEST;
     }
@@ -21,9 +21,16 @@ struct SELF_TEST_CONTEXT {
 
 WDF_DECLARE_CONTEXT_TYPE(SELF_TEST_CONTEXT);
 
+/** Default min interval in milliseconds between TailLightColorChanged events. */
+static constexpr ULONG DEFAULT_EVENT_INTERVAL = 100;
+
 // Initialize WMI provider
 NTSTATUS WmiInitialize(_In_ WDFDEVICE Device);
 
+/** Schedule a TailLightColorChanged event.
+    Events are coalesced to at most one per EventInterval. Callable at IRQL <= DISPATCH_LEVEL. */
+void WmiNotifyColorChanged(_In_ WDFDEVICE Device);
+
 EVT_WDF_WMI_INSTANCE_QUERY_INSTANCE EvtWmiInstanceQueryInstance;
 
 EVT_WDF_WMI_INSTANCE_SET_INSTANCE EvtWmiInstanceSetInstance;
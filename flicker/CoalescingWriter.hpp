@@ -0,0 +1,99 @@
+#pragma once
+#include "LightBackend.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+/** Asynchronous writer that keeps at most one Set call in flight on a backend.
+    A color queued while a write is in flight replaces any older queued color, so that the
+    latest color is always written next and colors superseded in the meantime are skipped.
+    Writes are issued from a worker thread. Runs on any platform. */
+class CoalescingWriter {
+public:
+    struct Stats {
+        unsigned int queued = 0;    // Set calls
+        unsigned int replaced = 0;  // queued colors replaced by a newer color before being written
+        unsigned int completed = 0; // successful writes
+        unsigned int failed = 0;    // failed writes
+    };
+
+    explicit CoalescingWriter(LightBackend& backend) : m_backend(backend) {
+        m_thread = std::thread(&CoalescingWriter::Run, this);
+    }
+
+    /** Waits for the in-flight write to complete. A queued color that is not yet written is discarded. */
+    ~CoalescingWriter() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    /** Queue color for writing. Returns immediately. */
+    void Set(uint32_t color) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.queued++;
+            if (m_hasPending)
+                m_stats.replaced++; // stale color never written
+            m_pending = color;
+            m_hasPending = true;
+        }
+        m_cv.notify_all();
+    }
+
+    /** Wait until all queued colors have been written. Returns false on timeout. */
+    bool Flush(std::chrono::milliseconds timeout = std::chrono::milliseconds::max()) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto idle = [this] { return !m_hasPending && !m_inFlight; };
+        if (timeout == std::chrono::milliseconds::max()) {
+            m_cv.wait(lock, idle);
+            return true;
+        }
+        return m_cv.wait_for(lock, timeout, idle);
+    }
+
+    Stats GetStats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_cv.wait(lock, [this] { return m_stop || m_hasPending; });
+            if (m_stop)
+                break;
+
+            uint32_t color = m_pending;
+            m_hasPending = false;
+            m_inFlight = true;
+            lock.unlock();
+
+            bool ok = m_backend.Set(color);
+
+            lock.lock();
+            m_inFlight = false;
+            if (ok)
+                m_stats.completed++;
+            else
+                m_stats.failed++;
+            m_cv.notify_all();
+        }
+    }
+
+    LightBackend&           m_backend;
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_cv;
+    bool                    m_hasPending = false; // color queued for writing
+    uint32_t                m_pending = 0;
+    bool                    m_inFlight = false;   // Set call in progress
+    bool                    m_stop = false;       // worker thread shall exit
+    Stats                   m_stats;
+    std::thread             m_thread;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include <windows.h>
+#include <wbemcli.h>
+#include <condition_variable>
+#include <mutex>
+
+
+/** Counts outstanding asynchronous operations, so that a caller can issue several operations
+    concurrently and wait for all of them to complete. Complete() may be called from any thread. */
+class CompletionLatch {
+public:
+    explicit CompletionLatch(size_t count) : m_remaining(count) {
+    }
+
+    /** Register completion of one operation. The first failure is kept as overall result. */
+    void Complete(HRESULT hr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if ((hr != WBEM_S_NO_ERROR) && (m_result == WBEM_S_NO_ERROR))
+            m_result = hr;
+        if (--m_remaining == 0)
+            m_cv.notify_all();
+    }
+
+    /** Wait for all operations to complete. Returns the first failure, or WBEM_S_NO_ERROR. */
+    HRESULT Wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_remaining == 0; });
+        return m_result;
+    }
+
+private:
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    size_t                  m_remaining = 0;
+    HRESULT                 m_result = WBEM_S_NO_ERROR;
+};
@@ -0,0 +1,55 @@
+#include <initguid.h> // define GUID_DEVINTERFACE_HID
+#include "HidLightBackend.hpp"
+#include "../HidUtil/HID.hpp"
+#include "../HidUtil/TailLight.hpp"
+#include <stdexcept>
+#include <tchar.h>
+
+
+struct HidLightBackend::Devices {
+    std::vector<HID::Match>      matches;
+    std::vector<TailLightWriter> writers; // refers to handles in "matches"
+};
+
+
+HidLightBackend::HidLightBackend() : m_devices(std::make_unique<Devices>()) {
+    HID::Query query;
+    query.VendorID = 0x045E;  // Microsoft
+    query.ProductID = 0x082A; // Pro IntelliMouse
+    query.Usage = 0x0212;     //
+    query.UsagePage = 0xFF07; //
+
+    m_devices->matches = HID::FindDevices(query);
+    for (HID::Match& match : m_devices->matches) {
+        TailLightWriter writer(match.dev.Get(), match.report, match.caps);
+        if (writer.IsValid())
+            m_devices->writers.push_back(writer);
+    }
+
+    if (m_devices->writers.empty()) {
+        _tprintf(TEXT("Could not find a tail-light HID device.\n"));
+        throw std::runtime_error("HID device failure");
+    }
+}
+
+HidLightBackend::~HidLightBackend() {
+}
+
+bool HidLightBackend::Set(uint32_t color) {
+    bool ok = true;
+    for (TailLightWriter& writer : m_devices->writers)
+        ok &= writer.Set(color);
+    return ok;
+}
+
+bool HidLightBackend::Get(uint32_t* color) {
+    if (!color)
+        return false;
+
+    COLORREF value = 0;
+    if (!m_devices->writers[0].Get(value))
+        return false;
+
+    *color = value;
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "LightBackend.hpp"
+#include <memory>
+
+
+/** Backend that sends tail-light feature reports directly through hid.dll instead of the driver WMI interface.
+    Controls all Pro IntelliMouse tail-light collections found on construction. */
+class HidLightBackend : public LightBackend {
+public:
+    /** Throws std::runtime_error if no device is found. */
+    HidLightBackend();
+    ~HidLightBackend() override;
+
+    bool Set(uint32_t color) override;
+    bool Get(uint32_t* color) override;
+
+private:
+    struct Devices; // defined in HidLightBackend.cpp, to keep hid.dll headers out of other translation units
+    std::unique_ptr<Devices> m_devices;
+};
@@ -0,0 +1,95 @@
+#include <initguid.h> // define GUID_DEVINTERFACE_TAILLIGHT
+#include "IoctlLightBackend.hpp"
+#include <cfgmgr32.h>
+#include <stdexcept>
+#include <string>
+#include <tchar.h>
+
+#pragma comment(lib, "cfgmgr32.lib")
+
+
+IoctlLightBackend::IoctlLightBackend() {
+    const ULONG searchScope = CM_GET_DEVICE_INTERFACE_LIST_PRESENT; // only currently 'live' device interfaces
+
+    ULONG length = 0;
+    CONFIGRET cr = CM_Get_Device_Interface_List_SizeW(&length, (GUID*)&GUID_DEVINTERFACE_TAILLIGHT, NULL, searchScope);
+    std::wstring interfaces(length, L'\0');
+    if (cr == CR_SUCCESS)
+        cr = CM_Get_Device_Interface_ListW((GUID*)&GUID_DEVINTERFACE_TAILLIGHT, NULL, interfaces.data(), length, searchScope);
+    if (cr != CR_SUCCESS) {
+        _tprintf(TEXT("Error %u: Failed to list TailLight interfaces.\n"), cr);
+        throw std::runtime_error("CM_Get_Device_Interface_List failure");
+    }
+
+    for (const wchar_t* name = interfaces.c_str(); *name; name += wcslen(name) + 1) {
+        HANDLE dev = CreateFileW(name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+        if (dev == INVALID_HANDLE_VALUE) {
+            _tprintf(TEXT("Error %u: Failed to open %s.\n"), GetLastError(), name);
+            continue;
+        }
+        m_devices.push_back(dev);
+    }
+
+    if (m_devices.empty()) {
+        _tprintf(TEXT("Could not find a TailLight IOCTL interface. Is the driver updated?\n"));
+        throw std::runtime_error("TailLight interface failure");
+    }
+}
+
+IoctlLightBackend::~IoctlLightBackend() {
+    for (HANDLE dev : m_devices)
+        CloseHandle(dev);
+}
+
+bool IoctlLightBackend::Set(uint32_t color) {
+    TAILLIGHT_COLOR input = {color};
+
+    bool ok = true;
+    for (HANDLE dev : m_devices) {
+        DWORD returned = 0;
+        if (!DeviceIoControl(dev, IOCTL_TAILLIGHT_SET_COLOR, &input, sizeof(input), NULL, 0, &returned, NULL)) {
+            _tprintf(TEXT("Error %u: IOCTL_TAILLIGHT_SET_COLOR failed.\n"), GetLastError());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool IoctlLightBackend::Get(uint32_t* color) {
+    if (!color)
+        return false;
+
+    TAILLIGHT_COLOR output = {};
+    DWORD returned = 0;
+    if (!DeviceIoControl(m_devices[0], IOCTL_TAILLIGHT_GET_COLOR, NULL, 0, &output, sizeof(output), &returned, NULL) || (returned != sizeof(output))) {
+        _tprintf(TEXT("Error %u: IOCTL_TAILLIGHT_GET_COLOR failed.\n"), GetLastError());
+        return false;
+    }
+
+    *color = output.Color;
+    return true;
+}
+
+bool IoctlLightBackend::UploadBatch(const std::vector<TAILLIGHT_BATCH_ENTRY>& entries, bool loop) {
+    if (entries.size() > TAILLIGHT_BATCH_MAX_ENTRIES)
+        return false;
+
+    // header followed by entries
+    const size_t headerSize = FIELD_OFFSET(TAILLIGHT_BATCH, Entries);
+    std::vector<BYTE> buffer(headerSize + entries.size() * sizeof(TAILLIGHT_BATCH_ENTRY));
+    auto* batch = (TAILLIGHT_BATCH*)buffer.data();
+    batch->Count = (ULONG)entries.size();
+    batch->Flags = loop ? TAILLIGHT_BATCH_LOOP : 0;
+    if (!entries.empty())
+        memcpy(batch->Entries, entries.data(), entries.size() * sizeof(TAILLIGHT_BATCH_ENTRY));
+
+    bool ok = true;
+    for (HANDLE dev : m_devices) {
+        DWORD returned = 0;
+        if (!DeviceIoControl(dev, IOCTL_TAILLIGHT_UPLOAD_BATCH, buffer.data(), (DWORD)buffer.size(), NULL, 0, &returned, NULL)) {
+            _tprintf(TEXT("Error %u: IOCTL_TAILLIGHT_UPLOAD_BATCH failed.\n"), GetLastError());
+            ok = false;
+        }
+    }
+    return ok;
+}
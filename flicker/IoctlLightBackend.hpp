@@ -0,0 +1,25 @@
+#pragma once
+#include "LightBackend.hpp"
+#include <windows.h>
+#include <winioctl.h>
+#include "../TailLight/TailLightIoctl.h"
+#include <vector>
+
+
+/** Backend that talks to the TailLight driver through its buffered IOCTL interface,
+    bypassing the WMI service. Controls all devices found on construction. */
+class IoctlLightBackend : public LightBackend {
+public:
+    /** Throws std::runtime_error if no device is found. */
+    IoctlLightBackend();
+    ~IoctlLightBackend() override;
+
+    bool Set(uint32_t color) override;
+    bool Get(uint32_t* color) override;
+
+    /** Upload a color sequence that the driver plays on its own timer. */
+    bool UploadBatch(const std::vector<TAILLIGHT_BATCH_ENTRY>& entries, bool loop);
+
+private:
+    std::vector<HANDLE> m_devices;
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include "PatternScheduler.hpp"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+/** Tail-light control backend. Colors are COLORREF values (0x00BBGGRR). */
+class LightBackend {
+public:
+    virtual ~LightBackend() = default;
+
+    /** Set color of all devices. */
+    virtual bool Set(uint32_t color) = 0;
+
+    /** Get color of the first device. */
+    virtual bool Get(uint32_t* color) = 0;
+};
+
+
+/** In-memory backend without devices. Records the time of each Set call, so that pattern
+    timing can be checked and profiled without hardware. Runs on any platform. */
+class MockLightBackend : public LightBackend {
+public:
+    struct Event {
+        SchedulerClock::duration time; // when the color was set
+        uint32_t                 color;
+    };
+
+    /** "latency" is the simulated duration of each Set call, spent on the given clock. */
+    explicit MockLightBackend(SchedulerClock& clock, SchedulerClock::duration latency = SchedulerClock::duration::zero()) : m_clock(clock), m_latency(latency) {
+    }
+
+    /** Make the next "count" Set calls fail. */
+    void FailNext(unsigned int count) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failures = count;
+    }
+
+    bool Set(uint32_t color) override {
+        if (m_latency > SchedulerClock::duration::zero())
+            m_clock.SleepUntil(m_clock.Now() + m_latency);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_failures > 0) {
+            m_failures--;
+            return false;
+        }
+        m_color = color;
+        m_events.push_back({m_clock.Now(), color});
+        return true;
+    }
+
+    bool Get(uint32_t* color) override {
+        if (!color)
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *color = m_color;
+        return true;
+    }
+
+    /** Colors set so far, in call order. */
+    std::vector<Event> Events() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_events;
+    }
+
+private:
+    SchedulerClock&          m_clock;
+    SchedulerClock::duration m_latency;
+    mutable std::mutex       m_mutex; // Set may be called from several threads
+    uint32_t                 m_color = 0;
+    unsigned int             m_failures = 0;
+    std::vector<Event>       m_events;
+};
@@ -1,13 +1,31 @@
 #include "luminous.hpp"
+#include "HidLightBackend.hpp"
+#include "IoctlLightBackend.hpp"
+#include "PatternScheduler.hpp"
+#include "PipeLightBackend.hpp"
 #include <dontuse.h>
 #include <Shlobj.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
 
+#pragma comment(lib, "winmm.lib") // for timeBeginPeriod
+
 #define USAGE  \
-_T("Usage: Flicker <-0 | -1 | -2>\n\
+_T("Usage: Flicker [--hid | --ioctl | --pipe] <--serve | -0 | -1 | -2 | -t | -a [Hz] | -b | -i | -l | -m [devices]>\n\
+    \t\t--hid controls the light through HID feature reports instead of WMI (only with --serve, -0, -1, -2 and -t) \n\
+    \t\t--ioctl controls the light through the TailLight driver IOCTL interface instead of WMI (only with --serve, -0, -1, -2 and -t) \n\
+    \t\t--pipe controls the light through a resident flicker --serve process (only with -0, -1, -2 and -t) \n\
+    \t\t--serve keeps running and applies colors received from flicker --pipe clients \n\
     \t\t-0 turns off light \n\
     \t\t-1 turns on light \n\
-    \t\t-2 flashes light ")
+    \t\t-2 flashes light \n\
+    \t\t-t measures time from startup to the first completed write \n\
+    \t\t-a flashes light with asynchronous writes at the requested rate (default 20 Hz) \n\
+    \t\t-b benchmarks Set calls per second \n\
+    \t\t-i compares writes per second through WMI and through the driver IOCTL interface \n\
+    \t\t-l lists devices \n\
+    \t\t-m benchmarks broadcast latency versus device count against mock devices (default 8 devices) ")
 
 
 COLORREF ToColor(bool val) {
@@ -17,69 +35,365 @@ COLORREF ToColor(bool val) {
         return RGB(255, 0, 0); // red
 }
 
+/** Flash pattern that speeds up from 500 ms to ~10 ms between toggles and then slows down again. */
+std::vector<PatternFrame> FlashPattern() {
+    std::vector<PatternFrame> frames;
+    int k=0;
+    int j=1;
+    for(int i = 500; (i>0)&&(j>0); i-=j) {
+        j = (i*9/100);
+        frames.push_back({std::chrono::milliseconds(i), ToColor(k)});
+        k=1-k;
+    }
+    for(int i = 12; i<500; i+=j) {
+        j = (i*9/100);
+        frames.push_back({std::chrono::milliseconds(i), ToColor(k)});
+        k=1-k;
+    }
+    if (k)
+        frames.push_back({std::chrono::milliseconds(0), ToColor(k)});
+    return frames;
+}
+
+void PrintTimingStats(const FrameTimingStats& stats) {
+    _tprintf(_T("%u frames, %u late: timing error mean %.0f us, std.dev. %.0f us, min %.0f us, max %.0f us (Set latency %.0f us)\n"),
+        stats.frames, stats.late, stats.mean, stats.stdDev, stats.min, stats.max, stats.setLatency);
+}
+
+/** Play the flash pattern and print timing statistics. */
+bool Flash(LightBackend& backend) {
+    SystemClock schedulerClock;
+    PatternScheduler scheduler(schedulerClock);
+    if (!scheduler.Play(FlashPattern(), [&backend](uint32_t color) { return backend.Set(color); }))
+        return false;
+
+    PrintTimingStats(scheduler.Stats());
+    return true;
+}
+
+/** Measure Set calls per second through named property access (before) and cached property handles (after). */
+bool Benchmark(Luminous& luminous, double seconds) {
+    using clock = std::chrono::steady_clock;
+
+    const TCHAR* names[] = {_T("by name"), _T("by handle")};
+    for (int mode = 0; mode < 2; mode++) {
+        ULONG count = 0;
+        auto start = clock::now();
+        auto end = start + std::chrono::duration<double>(seconds);
+        while (clock::now() < end) {
+            COLORREF color = RGB(0, count & 0x3F, 0); // dim colors within the driver power budget
+            bool ok = (mode == 0) ? luminous.SetByName(color) : luminous.Set(color);
+            if (!ok) {
+                _tprintf(_T("Set operation on Luminous failed.\n"));
+                return false;
+            }
+            count++;
+        }
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        _tprintf(_T("Set %s: %u calls in %.2f s (%.1f calls/s, %.3f ms/call)\n"), names[mode], count, elapsed, count/elapsed, 1000*elapsed/count);
+    }
+    return true;
+}
+
+/** Count successful writes per second through a backend. */
+double WritesPerSecond(LightBackend& backend, double seconds) {
+    using clock = std::chrono::steady_clock;
+
+    ULONG count = 0;
+    auto start = clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    while (clock::now() < end) {
+        if (!backend.Set(RGB(0, count & 0x3F, 0))) // dim colors within the driver power budget
+            return 0;
+        count++;
+    }
+    return count / std::chrono::duration<double>(clock::now() - start).count();
+}
+
+/** Compare writes per second through WMI PutInstance and through IOCTL_TAILLIGHT_SET_COLOR. */
+bool BenchmarkIoctl(double seconds) {
+    Luminous luminous;
+    WmiLightBackend wmi(luminous);
+    IoctlLightBackend ioctl;
+
+    double wmiRate = WritesPerSecond(wmi, seconds);
+    double ioctlRate = WritesPerSecond(ioctl, seconds);
+    if ((wmiRate == 0) || (ioctlRate == 0))
+        return false;
+
+    _tprintf(_T("WMI:   %.1f writes/s (%.3f ms/write)\n"), wmiRate, 1000/wmiRate);
+    _tprintf(_T("IOCTL: %.1f writes/s (%.3f ms/write)\n"), ioctlRate, 1000/ioctlRate);
+    _tprintf(_T("IOCTL speedup: %.1fx\n"), ioctlRate/wmiRate);
+
+    wmi.Set(RGB(0, 0, 0));
+    return true;
+}
+
+/** Flash light with pipelined asynchronous writes and report achieved versus requested flash rate.
+    Colors that are superseded before they can be written are skipped instead of delaying later colors. */
+bool FlashAsync(Luminous& luminous, double rate, double seconds) {
+    using clock = std::chrono::steady_clock;
+
+    std::vector<PatternFrame> frames;
+    const auto period = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double>(1.0 / rate));
+    for (ULONG toggle = 0; toggle < (ULONG)(seconds * rate); toggle++)
+        frames.push_back({toggle ? period : std::chrono::microseconds(0), ToColor(toggle % 2)});
+
+    SystemClock schedulerClock;
+    PatternScheduler scheduler(schedulerClock);
+    auto start = clock::now();
+    scheduler.Play(frames, [&luminous](uint32_t color) {
+        luminous.SetAsync(color);
+        return true;
+    });
+    bool flushed = luminous.Flush(2000); // 2 sec
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+    Luminous::AsyncStats stats = luminous.GetAsyncStats();
+    _tprintf(_T("Requested %.1f Hz, achieved %.1f Hz (%u colors queued, %u written, %u stale colors replaced, %u failed)\n"),
+        rate, stats.completed/elapsed, stats.queued, stats.completed, stats.replaced, stats.failed);
+    PrintTimingStats(scheduler.Stats());
+    return flushed && (stats.failed == 0);
+}
+
+/** In-process stand-in for a WMI device instance. Each write completes after a fixed latency,
+    and asynchronous writes complete on thread pool threads through the sink, like PutInstanceAsync. */
+class MockDeviceWriter : public DeviceWriter {
+public:
+    explicit MockDeviceWriter(DWORD latencyMs) : m_latencyMs(latencyMs) {
+    }
+
+    HRESULT Read(COLORREF* Color) override {
+        *Color = m_color;
+        return WBEM_S_NO_ERROR;
+    }
+
+    HRESULT Put(COLORREF Color) override {
+        Sleep(m_latencyMs);
+        m_color = Color;
+        return WBEM_S_NO_ERROR;
+    }
+
+    HRESULT PutAsync(COLORREF Color, IWbemObjectSink* sink) override {
+        auto* work = new Work{this, Color, sink};
+        if (!TrySubmitThreadpoolCallback(Callback, work, NULL)) {
+            DWORD err = GetLastError();
+            delete work;
+            return HRESULT_FROM_WIN32(err);
+        }
+        return WBEM_S_NO_ERROR;
+    }
+
+private:
+    struct Work {
+        MockDeviceWriter*        writer;
+        COLORREF                 color;
+        CComPtr<IWbemObjectSink> sink;
+    };
+
+    static void CALLBACK Callback(PTP_CALLBACK_INSTANCE instance, void* context) {
+        std::unique_ptr<Work> work(static_cast<Work*>(context));
+        CallbackMayRunLong(instance); // simulated provider latency blocks the thread
+        Sleep(work->writer->m_latencyMs);
+        work->writer->m_color = work->color;
+        work->sink->SetStatus(WBEM_STATUS_COMPLETE, WBEM_S_NO_ERROR, NULL, NULL);
+    }
+
+    DWORD                 m_latencyMs = 0;
+    std::atomic<COLORREF> m_color = 0;
+};
+
+/** Compare broadcast latency of serial writes (one device after the other) with the concurrent
+    Luminous::Set broadcast (issue all, then wait for all) for an increasing number of mock devices. */
+bool BenchmarkBroadcast(ULONG maxDevices) {
+    using clock = std::chrono::steady_clock;
+    const DWORD latencyMs = 2; // simulated PutInstance round trip
+    const ULONG iterations = 50;
+
+    timeBeginPeriod(1); // 1 ms Sleep granularity
+
+    _tprintf(_T("Mock device latency %u ms, %u broadcasts per device count\n"), latencyMs, iterations);
+    _tprintf(_T("%8s %12s %12s\n"), _T("devices"), _T("serial ms"), _T("concurrent ms"));
+    bool ok = true;
+    for (ULONG devices = 1; devices <= maxDevices; devices *= 2) {
+        std::map<std::wstring, std::unique_ptr<DeviceWriter>> writers;
+        for (ULONG d = 0; d < devices; d++)
+            writers[L"Mock_" + std::to_wstring(d)] = std::make_unique<MockDeviceWriter>(latencyMs);
+        Luminous luminous(std::move(writers));
+        std::vector<std::wstring> names = luminous.InstanceNames();
+
+        auto start = clock::now();
+        for (ULONG i = 0; i < iterations; i++) {
+            for (const std::wstring& name : names)
+                ok &= luminous.Set(name, RGB(0, i & 0x3F, 0));
+        }
+        double serial = std::chrono::duration<double, std::milli>(clock::now() - start).count() / iterations;
+
+        start = clock::now();
+        for (ULONG i = 0; i < iterations; i++)
+            ok &= luminous.Set(RGB(0, i & 0x3F, 0));
+        double concurrent = std::chrono::duration<double, std::milli>(clock::now() - start).count() / iterations;
+
+        _tprintf(_T("%8u %12.2f %12.2f\n"), devices, serial, concurrent);
+    }
+
+    timeEndPeriod(1);
+    return ok;
+}
+
 int main(_In_ ULONG argc, _In_reads_(argc) PCHAR argv[]) {
+    const auto startTime = std::chrono::steady_clock::now();
+    bool  bHid = false;
+    bool  bIoctl = false;
+    bool  bPipe = false;
+    bool  bServe = false;
+    bool  bStartupTiming = false;
     bool  bAdjustLight = false;
+    bool  bBenchmark = false;
+    bool  bIoctlBenchmark = false;
+    bool  bAsync = false;
+    bool  bList = false;
+    bool  bMockBroadcast = false;
+    double asyncRate = 20; // Hz
+    ULONG mockDevices = 8;
     ULONG lightSetting = 0;
 
-    if (argc == 2) {
+    while (argc >= 2) {
+        if (strcmp(argv[1], "--hid") == 0)
+            bHid = true;
+        else if (strcmp(argv[1], "--ioctl") == 0)
+            bIoctl = true;
+        else if (strcmp(argv[1], "--pipe") == 0)
+            bPipe = true;
+        else if (strcmp(argv[1], "--serve") == 0)
+            bServe = true;
+        else
+            break;
+        argc--;
+        argv++;
+    }
+
+    if ((argc == 2) || (argc == 3)) {
         if (argv[1][0] == '-') {
-            if ((argv[1][1] >= '0') && (argv[1][1] <= '2')) {
+            if ((argc == 2) && (argv[1][1] >= '0') && (argv[1][1] <= '2')) {
                 bAdjustLight = true;
                 lightSetting = (argv[1][1] - '0');
+            } else if ((argc == 2) && (argv[1][1] == 'b')) {
+                bBenchmark = true;
+            } else if ((argc == 2) && (argv[1][1] == 'i')) {
+                bIoctlBenchmark = true;
+            } else if (argv[1][1] == 'a') {
+                bAsync = true;
+                if (argc == 3)
+                    asyncRate = atof(argv[2]);
+                if (asyncRate <= 0)
+                    bAsync = false;
+            } else if ((argc == 2) && (argv[1][1] == 't')) {
+                bStartupTiming = true;
+            } else if ((argc == 2) && (argv[1][1] == 'l')) {
+                bList = true;
+            } else if (argv[1][1] == 'm') {
+                bMockBroadcast = true;
+                if (argc == 3)
+                    mockDevices = atoi(argv[2]);
+                if (mockDevices == 0)
+                    bMockBroadcast = false;
             }
         }
      }
 
-    if  (!bAdjustLight) {
+    bool bAnyBackend = bServe || bAdjustLight || bStartupTiming; // modes supported by all backends
+    int backendOptions = bHid + bIoctl + bPipe;
+    if  ((!bAnyBackend && !bBenchmark && !bIoctlBenchmark && !bAsync && !bList && !bMockBroadcast) || ((backendOptions > 0) && !bAnyBackend) ||
+        (backendOptions > 1) || (bServe && (bPipe || (argc > 1)))) {
         _tprintf(USAGE);
         exit(0);
     }
 
-    auto luminous = std::make_unique<Luminous>();
+    if (bIoctlBenchmark) {
+        if (!BenchmarkIoctl(5.0))
+            _tprintf(_T("IOCTL benchmark failed.\n"));
+        return 0;
+    }
+
+    if (bMockBroadcast) {
+        // no devices needed
+        if (!BenchmarkBroadcast(mockDevices))
+            _tprintf(_T("Mock broadcast failed.\n"));
+        return 0;
+    }
+
+    std::unique_ptr<Luminous> luminous;
+    std::unique_ptr<LightBackend> backend;
+    if (bHid) {
+        backend = std::make_unique<HidLightBackend>();
+    } else if (bIoctl) {
+        backend = std::make_unique<IoctlLightBackend>();
+    } else if (bPipe) {
+        backend = std::make_unique<PipeLightBackend>();
+    } else {
+        luminous = std::make_unique<Luminous>();
+
+        if (luminous == NULL) {
+            _tprintf(_T("Problem creating Luminous\n"));
+            return 0;
+        }
+        backend = std::make_unique<WmiLightBackend>(*luminous);
+    }
 
-    if (luminous == NULL) {
-        _tprintf(_T("Problem creating Luminous\n"));
+    if (bServe) {
+        _tprintf(_T("Serving %s\n"), LIGHT_PIPE_NAME);
+        ServeLightPipe(*backend);
         return 0;
     }
 
+    if (bStartupTiming) {
+        if (!backend->Set(ToColor(true))) {
+            _tprintf(_T("Set operation on Luminous failed.\n"));
+            return 0;
+        }
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        const TCHAR* path = bHid ? _T("HID") : bIoctl ? _T("IOCTL") : bPipe ? _T("pipe") : _T("WMI");
+        _tprintf(_T("Startup to first write through %s: %.1f ms\n"), path, elapsed);
+    }
+
+    if (bList) {
+        for (const std::wstring& name : luminous->InstanceNames()) {
+            COLORREF color = 0;
+            if (luminous->Get(name, &color))
+                _tprintf(_T("%s: color %06X\n"), name.c_str(), color);
+        }
+        return 0;
+    }
+
+    if (bBenchmark) {
+        if (!Benchmark(*luminous, 5.0))
+            return 0;
+    }
+
+    if (bAsync) {
+        if (!FlashAsync(*luminous, asyncRate, 5.0))
+            _tprintf(_T("Asynchronous Set operations on Luminous failed.\n"));
+    }
+
     if (bAdjustLight) {
         if (lightSetting < 2) {
-            bool ok = luminous->Set(ToColor(lightSetting));
+            bool ok = backend->Set(ToColor(lightSetting));
             if (ok)
                 _tprintf(_T("Adjusted light to %x\n"), lightSetting);
             else
                 _tprintf(_T("Problem occured while adjusting light: %x\n"), GetLastError());
             Sleep(1000); // 1 sec
         } else {
-            int k=0;
-            int j=1;
-            for(int i = 500; (i>0)&&(j>0); i-=j) {
-                j = (i*9/100);
-                Sleep(i);
-                if(!luminous->Set(ToColor(k))) {
-                    _tprintf(_T("Set operation on Luminous failed.\n"));
-                    return 0;
-                }
-                k=1-k;
-            }
-            for(int i = 12; i<500; i+=j) {
-                j = (i*9/100);
-                Sleep(i);
-                if(!luminous->Set(ToColor(k))) {
-                    _tprintf(_T("Set operation on Luminous failed.\n"));
-                    return 0;
-                }
-                k=1-k;
-            }
-            if (k) {
-                if(!luminous->Set(ToColor(k)))
-                    _tprintf(_T("Set operation on Luminous failed.\n"));
+            if (!Flash(*backend)) {
+                _tprintf(_T("Set operation on Luminous failed.\n"));
+                return 0;
             }
         }
     }
 
     // set color back to black
-    luminous->Set(RGB(0, 0, 0));
+    backend->Set(RGB(0, 0, 0));
 
     return 0;
 }
@@ -0,0 +1,195 @@
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+/** Step of a light pattern: color to set once "delay" has elapsed since the previous step. */
+struct PatternFrame {
+    std::chrono::microseconds delay;
+    uint32_t                  color; // COLORREF
+};
+
+
+/** Time source of PatternScheduler. Times are relative to an arbitrary epoch. */
+class SchedulerClock {
+public:
+    using duration = std::chrono::nanoseconds;
+
+    virtual ~SchedulerClock() = default;
+
+    virtual duration Now() = 0;
+
+    /** Block until the given absolute time. */
+    virtual void SleepUntil(duration deadline) = 0;
+};
+
+
+/** Monotonic system clock. Sleeps use a high-resolution waitable timer on Windows
+    and absolute clock_nanosleep elsewhere, so that wake-ups are not rounded to the scheduler tick. */
+class SystemClock : public SchedulerClock {
+public:
+    SystemClock() {
+#ifdef _WIN32
+        m_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!m_timer)
+            m_timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS); // high resolution not supported before Windows 10 1803
+#endif
+    }
+    ~SystemClock() override {
+#ifdef _WIN32
+        if (m_timer)
+            CloseHandle(m_timer);
+#endif
+    }
+
+    duration Now() override {
+        return std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch());
+    }
+
+    void SleepUntil(duration deadline) override {
+#ifdef _WIN32
+        duration remaining = deadline - Now();
+        if (remaining <= duration::zero())
+            return;
+
+        LARGE_INTEGER dueTime = {};
+        dueTime.QuadPart = -(LONGLONG)(remaining.count() / 100); // relative time in 100ns units
+        if (m_timer && SetWaitableTimer(m_timer, &dueTime, 0, NULL, NULL, FALSE))
+            WaitForSingleObject(m_timer, INFINITE);
+        else
+            Sleep((DWORD)std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+#else
+        // steady_clock is CLOCK_MONOTONIC
+        timespec ts = {};
+        ts.tv_sec = (time_t)(deadline.count() / 1000000000);
+        ts.tv_nsec = (long)(deadline.count() % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+            // retry if interrupted by a signal (other errors would repeat forever)
+        }
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE m_timer = NULL;
+#endif
+};
+
+
+/** Deterministic clock for tests. Sleeping advances time instantly,
+    and Advance() simulates time spent in operations such as Set. */
+class FakeClock : public SchedulerClock {
+public:
+    duration Now() override {
+        return m_now;
+    }
+
+    void SleepUntil(duration deadline) override {
+        if (deadline > m_now)
+            m_now = deadline;
+    }
+
+    void Advance(duration delta) {
+        m_now += delta;
+    }
+
+private:
+    duration m_now = duration::zero();
+};
+
+
+/** Per-frame timing error statistics. The error is the time at which the color was set
+    (Set call returned) minus the frame deadline; positive values are late. */
+struct FrameTimingStats {
+    unsigned int frames = 0;
+    unsigned int late = 0;    // frames more than "tolerance" late
+    double       mean = 0;    // mean error [us]
+    double       stdDev = 0;  // error standard deviation [us]
+    double       min = 0;     // [us]
+    double       max = 0;     // [us]
+    double       setLatency = 0; // final Set latency estimate [us]
+};
+
+
+/** Plays light patterns against absolute deadlines, so that sleep granularity and Set durations don't accumulate drift.
+    Each Set call is issued ahead of its deadline by the estimated Set latency, which is
+    tracked as a moving average of measured Set durations. */
+class PatternScheduler {
+public:
+    explicit PatternScheduler(SchedulerClock& clock) : m_clock(clock) {
+    }
+
+    /** Frames more than this late are counted as late in the statistics. */
+    void SetTolerance(std::chrono::microseconds tolerance) {
+        m_tolerance = tolerance;
+    }
+
+    /** Play frames. "set" is called as bool(uint32_t color) and returns false on failure,
+        which aborts playback. Returns false if playback was aborted. */
+    template <class SetFn>
+    bool Play(const std::vector<PatternFrame>& frames, SetFn set) {
+        using duration = SchedulerClock::duration;
+
+        m_errors.clear();
+        duration deadline = m_clock.Now();
+        for (const PatternFrame& frame : frames) {
+            deadline += frame.delay;
+
+            // issue early by the estimated Set latency, so that the color changes at the deadline
+            m_clock.SleepUntil(deadline - m_setLatency);
+
+            duration t0 = m_clock.Now();
+            if (!set(frame.color))
+                return false;
+            duration t1 = m_clock.Now();
+
+            if (m_latencySamples++ == 0)
+                m_setLatency = t1 - t0;
+            else
+                m_setLatency = (m_setLatency * 7 + (t1 - t0)) / 8; // exponential moving average
+            m_errors.push_back(std::chrono::duration<double, std::micro>(t1 - deadline).count());
+        }
+        return true;
+    }
+
+    /** Timing statistics of the last Play call. */
+    FrameTimingStats Stats() const {
+        FrameTimingStats stats;
+        stats.frames = (unsigned int)m_errors.size();
+        stats.setLatency = std::chrono::duration<double, std::micro>(m_setLatency).count();
+        if (m_errors.empty())
+            return stats;
+
+        stats.min = stats.max = m_errors[0];
+        double sum = 0;
+        for (double e : m_errors) {
+            sum += e;
+            stats.min = (e < stats.min) ? e : stats.min;
+            stats.max = (e > stats.max) ? e : stats.max;
+            if (e > m_tolerance.count())
+                stats.late++;
+        }
+        stats.mean = sum / m_errors.size();
+
+        double sq = 0;
+        for (double e : m_errors)
+            sq += (e - stats.mean) * (e - stats.mean);
+        stats.stdDev = (m_errors.size() > 1) ? std::sqrt(sq / (m_errors.size() - 1)) : 0;
+        return stats;
+    }
+
+private:
+    SchedulerClock&           m_clock;
+    SchedulerClock::duration  m_setLatency = SchedulerClock::duration::zero(); // Set latency estimate
+    unsigned int              m_latencySamples = 0;
+    std::chrono::microseconds m_tolerance{1000}; // 1 ms
+    std::vector<double>       m_errors; // per-frame timing errors of last Play [us]
+};
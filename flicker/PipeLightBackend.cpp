@@ -0,0 +1,145 @@
+#include "PipeLightBackend.hpp"
+#include <sddl.h>
+#include <mutex>
+#include <stdexcept>
+#include <tchar.h>
+#include <thread>
+
+#pragma comment(lib, "advapi32.lib") // for ConvertStringSecurityDescriptorToSecurityDescriptorW
+
+
+/** Pipe DACL matching the driver interfaces (SDDL_DEVOBJ_SYS_ALL_ADM_RWX_WORLD_RW_RES_R): Full access for SYSTEM,
+    administrators and the server owner, and read & write for everyone, so that non-admin clients can connect to an
+    elevated server. 0x12019B is FILE_GENERIC_READ | FILE_GENERIC_WRITE without FILE_CREATE_PIPE_INSTANCE,
+    so that clients can't create server instances of their own. */
+static constexpr wchar_t LIGHT_PIPE_SDDL[] = L"D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)(A;;0x12019B;;;WD)";
+
+
+PipeLightBackend::PipeLightBackend() {
+    for (;;) {
+        m_pipe = CreateFileW(LIGHT_PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (m_pipe != INVALID_HANDLE_VALUE)
+            break;
+
+        // all pipe instances busy until the server has created a new one
+        if ((GetLastError() != ERROR_PIPE_BUSY) || !WaitNamedPipeW(LIGHT_PIPE_NAME, 2000)) { // 2 sec
+            _tprintf(TEXT("Error %u: Could not connect to %s. Is \"flicker --serve\" running?\n"), GetLastError(), LIGHT_PIPE_NAME);
+            throw std::runtime_error("pipe connect failure");
+        }
+    }
+
+    DWORD mode = PIPE_READMODE_MESSAGE;
+    if (!SetNamedPipeHandleState(m_pipe, &mode, NULL, NULL)) {
+        _tprintf(TEXT("Error %u: Failed to switch pipe to message mode.\n"), GetLastError());
+        CloseHandle(m_pipe);
+        throw std::runtime_error("pipe mode failure");
+    }
+}
+
+PipeLightBackend::~PipeLightBackend() {
+    CloseHandle(m_pipe);
+}
+
+bool PipeLightBackend::Set(uint32_t color) {
+    LightPipeRequest request;
+    request.command = LightPipeRequest::SET;
+    request.color = color;
+
+    LightPipeReply reply;
+    return Transact(request, reply);
+}
+
+bool PipeLightBackend::Get(uint32_t* color) {
+    if (!color)
+        return false;
+
+    LightPipeRequest request;
+    request.command = LightPipeRequest::GET;
+
+    LightPipeReply reply;
+    if (!Transact(request, reply))
+        return false;
+
+    *color = reply.color;
+    return true;
+}
+
+bool PipeLightBackend::Transact(const LightPipeRequest& request, LightPipeReply& reply) {
+    // write request and read reply in a single round trip
+    DWORD read = 0;
+    if (!TransactNamedPipe(m_pipe, (void*)&request, sizeof(request), &reply, sizeof(reply), &read, NULL)) {
+        _tprintf(TEXT("Error %u: Pipe transaction failed.\n"), GetLastError());
+        return false;
+    }
+
+    return (read == sizeof(reply)) && reply.success;
+}
+
+
+/** Serve requests of a connected client until it disconnects. */
+static void ServeClient(HANDLE pipe, LightBackend& backend, std::mutex& backendMutex) {
+    for (;;) {
+        LightPipeRequest request;
+        DWORD read = 0;
+        if (!ReadFile(pipe, &request, sizeof(request), &read, NULL) || (read != sizeof(request)))
+            break; // disconnected or malformed message
+
+        LightPipeReply reply;
+        {
+            std::lock_guard<std::mutex> lock(backendMutex);
+            if (request.command == LightPipeRequest::SET)
+                reply.success = backend.Set(request.color);
+            else if (request.command == LightPipeRequest::GET)
+                reply.success = backend.Get(&reply.color);
+        }
+
+        DWORD written = 0;
+        if (!WriteFile(pipe, &reply, sizeof(reply), &written, NULL))
+            break;
+    }
+
+    DisconnectNamedPipe(pipe);
+    CloseHandle(pipe);
+}
+
+bool ServeLightPipe(LightBackend& backend) {
+    static std::mutex backendMutex; // outlives client threads
+
+    PSECURITY_DESCRIPTOR securityDescriptor = NULL;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(LIGHT_PIPE_SDDL, SDDL_REVISION_1, &securityDescriptor, NULL)) {
+        _tprintf(TEXT("Error %u: Failed to create pipe security descriptor.\n"), GetLastError());
+        return false;
+    }
+    SECURITY_ATTRIBUTES security = {sizeof(security), securityDescriptor, FALSE};
+
+    // the first instance fails if another process already owns the pipe name (pipe squatting)
+    DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE;
+    for (;;) {
+        HANDLE pipe = CreateNamedPipeW(LIGHT_PIPE_NAME,
+            openMode,
+            PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES,
+            sizeof(LightPipeReply),   // output buffer size
+            sizeof(LightPipeRequest), // input buffer size
+            0,                        // default timeout
+            &security);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            DWORD err = GetLastError();
+            if ((openMode & FILE_FLAG_FIRST_PIPE_INSTANCE) && (err == ERROR_ACCESS_DENIED))
+                _tprintf(TEXT("Error: %s is already served by another process.\n"), LIGHT_PIPE_NAME);
+            else
+                _tprintf(TEXT("Error %u: Failed to create pipe %s.\n"), err, LIGHT_PIPE_NAME);
+            LocalFree(securityDescriptor);
+            return false;
+        }
+        openMode &= ~FILE_FLAG_FIRST_PIPE_INSTANCE; // further instances of our own pipe
+
+        // wait for client (ERROR_PIPE_CONNECTED if the client connected before this call)
+        if (!ConnectNamedPipe(pipe, NULL) && (GetLastError() != ERROR_PIPE_CONNECTED)) {
+            CloseHandle(pipe);
+            continue;
+        }
+
+        std::thread(ServeClient, pipe, std::ref(backend), std::ref(backendMutex)).detach();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "LightBackend.hpp"
+#include <windows.h>
+
+
+/** Named pipe served by "flicker --serve". */
+static constexpr wchar_t LIGHT_PIPE_NAME[] = L"\\\\.\\pipe\\TailLight";
+
+/** Pipe request message. */
+struct LightPipeRequest {
+    enum : uint32_t {
+        SET = 1,
+        GET = 2,
+    };
+    uint32_t command = 0;
+    uint32_t color = 0;   // COLORREF for SET
+};
+
+/** Pipe reply message. */
+struct LightPipeReply {
+    uint32_t success = 0; // 1 on success
+    uint32_t color = 0;   // COLORREF for GET
+};
+
+
+/** Thin client that forwards colors to a resident "flicker --serve" process over a named pipe.
+    The server keeps the WMI connection and instance references warm, so that a client
+    doesn't pay COM initialization, namespace connection and instance enumeration on startup. */
+class PipeLightBackend : public LightBackend {
+public:
+    /** Throws std::runtime_error if the server is not running. */
+    PipeLightBackend();
+    ~PipeLightBackend() override;
+
+    bool Set(uint32_t color) override;
+    bool Get(uint32_t* color) override;
+
+private:
+    bool Transact(const LightPipeRequest& request, LightPipeReply& reply);
+
+    HANDLE m_pipe = INVALID_HANDLE_VALUE;
+};
+
+
+/** Resident server that applies colors received over the pipe to a backend. Each client is served on its own thread,
+    and backend calls are serialized. Runs until the process is terminated.
+    Returns false if the pipe can't be created, for instance because another process already serves it. */
+bool ServeLightPipe(LightBackend& backend);
@@ -1,4 +1,6 @@
 #include "luminous.hpp"
+#include "CompletionLatch.hpp"
+#include <chrono>
 #include <stdexcept>
 
 #pragma comment(lib, "wbemuuid.lib")
@@ -59,8 +61,8 @@ CComPtr<IWbemServices> ConnectToNamespace(_In_ const wchar_t* chNamespace) {
     return wbemServices;
 }
 
-// The function returns an interface pointer to the instance given its list-index.
-CComPtr<IWbemClassObject> GetInstanceReference(IWbemServices& pIWbemServices, _In_ const wchar_t* lpClassName) {
+// The function returns interface pointers to all instances of a class.
+std::vector<CComPtr<IWbemClassObject>> GetInstances(IWbemServices& pIWbemServices, _In_ const wchar_t* lpClassName) {
     // Get Instance Enumerator Interface.
     CComPtr<IEnumWbemClassObject> enumInst;
     HRESULT hr = pIWbemServices.CreateInstanceEnum(
@@ -72,10 +74,11 @@ CComPtr<IWbemClassObject> GetInstanceReference(IWbemServices& pIWbemServices, _I
 
     if (hr != WBEM_S_NO_ERROR || enumInst == NULL) {
         _tprintf(TEXT("Error %lX: Failed to get a reference to instance enumerator.\n"), hr);
-        return nullptr;
+        return {};
     }
 
-    // Get pointer to the instance.
+    // Get pointers to the instances.
+    std::vector<CComPtr<IWbemClassObject>> instances;
     hr = WBEM_S_NO_ERROR;
     while (hr == WBEM_S_NO_ERROR) {
         ULONG count = 0;
@@ -87,16 +90,104 @@ CComPtr<IWbemClassObject> GetInstanceReference(IWbemServices& pIWbemServices, _I
             &count); // Number of instances returned.
 
         if (count > 0)
-            return inst;
+            instances.push_back(inst);
     }
 
-    return nullptr;
+    return instances;
 }
 
 
+/** DeviceWriter of a TailLightDeviceInformation instance. Uses a property handle resolved once,
+    so that reads and writes avoid BSTR allocations and variant conversions. */
+class WmiDeviceWriter : public DeviceWriter {
+public:
+    WmiDeviceWriter(IWbemServices* wbemServices, IWbemClassObject* wbemClassObject, IWbemObjectAccess* wbemObjectAccess, long propertyHandle)
+        : m_wbemServices(wbemServices), m_wbemClassObject(wbemClassObject), m_wbemObjectAccess(wbemObjectAccess), m_propertyHandle(propertyHandle) {
+    }
+
+    HRESULT Read(COLORREF* Color) override {
+        DWORD value = 0;
+        HRESULT hr = m_wbemObjectAccess->ReadDWORD(m_propertyHandle, &value);
+        if (hr == WBEM_S_NO_ERROR)
+            *Color = value;
+        return hr;
+    }
+
+    HRESULT Put(COLORREF Color) override {
+        HRESULT hr = m_wbemObjectAccess->WriteDWORD(m_propertyHandle, Color);
+        if (hr != WBEM_S_NO_ERROR)
+            return hr;
+
+        return m_wbemServices->PutInstance(m_wbemClassObject, WBEM_FLAG_UPDATE_ONLY, NULL, NULL);
+    }
+
+    HRESULT PutAsync(COLORREF Color, IWbemObjectSink* sink) override {
+        // the instance object must not be modified again before the write has completed
+        HRESULT hr = m_wbemObjectAccess->WriteDWORD(m_propertyHandle, Color);
+        if (hr != WBEM_S_NO_ERROR)
+            return hr;
+
+        return m_wbemServices->PutInstanceAsync(m_wbemClassObject, WBEM_FLAG_UPDATE_ONLY, NULL, sink);
+    }
+
+private:
+    CComPtr<IWbemServices>     m_wbemServices;
+    CComPtr<IWbemClassObject>  m_wbemClassObject;
+    CComPtr<IWbemObjectAccess> m_wbemObjectAccess; // fast property access
+    long                       m_propertyHandle = 0; // handle of PROPERTY_NAME (same for all instances of the class)
+};
+
+
+/** Sink that receives the completion status of a PutInstanceAsync call. */
+class PutInstanceSink : public IWbemObjectSink {
+public:
+    PutInstanceSink(std::function<void(HRESULT)> onComplete) : m_onComplete(std::move(onComplete)) {
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override {
+        return InterlockedIncrement(&m_ref);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG ref = InterlockedDecrement(&m_ref);
+        if (ref == 0)
+            delete this;
+        return ref;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override {
+        if ((riid == IID_IUnknown) || (riid == IID_IWbemObjectSink)) {
+            *ppv = static_cast<IWbemObjectSink*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Indicate(LONG /*lObjectCount*/, IWbemClassObject** /*apObjArray*/) override {
+        return WBEM_S_NO_ERROR; // no objects returned by PutInstanceAsync
+    }
+
+    HRESULT STDMETHODCALLTYPE SetStatus(LONG lFlags, HRESULT hResult, BSTR /*strParam*/, IWbemClassObject* /*pObjParam*/) override {
+        if (lFlags != WBEM_STATUS_COMPLETE)
+            return WBEM_S_NO_ERROR;
+
+        m_onComplete(hResult);
+        return WBEM_S_NO_ERROR;
+    }
+
+private:
+    LONG m_ref = 1;
+    std::function<void(HRESULT)> m_onComplete;
+};
+
+
 Luminous::Luminous() {
     // Initialize COM library. Must be done before invoking any other COM function.
-    HRESULT hr = CoInitialize(NULL);
+    // Multithreaded apartment, so that the interfaces can be used from the async writer thread
+    // and completion sinks are called without a message loop.
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
 
     if ( FAILED (hr)) {
         _tprintf( TEXT("Error %lx: Failed to initialize COM library\n"), hr);
@@ -110,79 +201,226 @@ Luminous::Luminous() {
         throw std::runtime_error("ConnectToNamespace failure");
     }
 
-    m_wbemClassObject = GetInstanceReference(*m_wbemServices, CLASS_NAME);
-     if ( !m_wbemClassObject) {
+    std::vector<CComPtr<IWbemClassObject>> instances = GetInstances(*m_wbemServices, CLASS_NAME);
+    if (instances.empty()) {
         _tprintf( TEXT("Could not find the instance.\n") );
-        throw std::runtime_error("GetInstanceReference failure");
+        throw std::runtime_error("GetInstances failure");
+    }
+
+    long propertyHandle = 0;
+    for (CComPtr<IWbemClassObject>& instance : instances) {
+        // instance names identify the device (device instance ID with a suffix)
+        CComVariant instanceName;
+        hr = instance->Get(L"InstanceName", 0, &instanceName, NULL, NULL);
+        if ((hr != WBEM_S_NO_ERROR) || (instanceName.vt != VT_BSTR)) {
+            _tprintf(TEXT("Error %lX: Failed to read InstanceName.\n"), hr);
+            throw std::runtime_error("InstanceName failure");
+        }
+
+        // Resolve property handle once, so that Get & Set avoid BSTR allocations and variant conversions
+        CComPtr<IWbemObjectAccess> wbemObjectAccess;
+        hr = instance.QueryInterface(&wbemObjectAccess);
+        if (FAILED(hr)) {
+            _tprintf(TEXT("Error %lX: Failed to get IWbemObjectAccess interface.\n"), hr);
+            throw std::runtime_error("IWbemObjectAccess failure");
+        }
+
+        if (m_devices.empty()) {
+            CIMTYPE cimType = 0;
+            hr = wbemObjectAccess->GetPropertyHandle(PROPERTY_NAME, &cimType, &propertyHandle);
+            if (hr != WBEM_S_NO_ERROR) {
+                _tprintf(TEXT("Error %lX: Failed to get handle of property %s.\n"), hr, PROPERTY_NAME);
+                throw std::runtime_error("GetPropertyHandle failure");
+            }
+
+            if ((cimType != CIM_UINT32) && (cimType != CIM_SINT32)) {
+                _tprintf(TEXT("Unexpected type %u of property %s.\n"), cimType, PROPERTY_NAME);
+                throw std::runtime_error("property type mismatch");
+            }
+        }
+
+        Device& device = m_devices[instanceName.bstrVal];
+        device.writer = std::make_unique<WmiDeviceWriter>(m_wbemServices, instance, wbemObjectAccess, propertyHandle);
+        device.wbemClassObject = instance;
     }
 }
 
+Luminous::Luminous(std::map<std::wstring, std::unique_ptr<DeviceWriter>> writers) {
+    if (writers.empty())
+        throw std::runtime_error("no devices");
+
+    // same apartment as with WMI, so that completion sinks are called the same way
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    if (FAILED(hr)) {
+        _tprintf(TEXT("Error %lx: Failed to initialize COM library\n"), hr);
+        throw std::runtime_error("CoInitialize failure");
+    }
+
+    for (auto& entry : writers)
+        m_devices[entry.first].writer = std::move(entry.second);
+}
+
 Luminous::~Luminous() {
+    if (m_async) {
+        Flush(2000); // 2 sec
+        m_async.reset();
+    }
+
+    m_devices.clear();
     m_wbemServices.Release();
-    m_wbemClassObject.Release();
 
     CoUninitialize();
 }
 
 
 bool Luminous::Get(COLORREF* Color) {
+    return Get(m_devices.begin()->first, Color);
+}
+
+bool Luminous::Get(const std::wstring& instanceName, COLORREF* Color) {
     if (!Color)
         return false;
 
+    auto it = m_devices.find(instanceName);
+    if (it == m_devices.end())
+        return false;
+
     // Get the property value.
-    CComVariant varPropVal;
-    CIMTYPE  cimType = 0;
-    HRESULT hr = m_wbemClassObject->Get(CComBSTR(PROPERTY_NAME), 0, &varPropVal, &cimType, NULL);
+    HRESULT hr = it->second.writer->Read(Color);
 
     if (hr != WBEM_S_NO_ERROR) {
         _tprintf( TEXT("Error %lX: Failed to read property value of %s.\n"), hr, PROPERTY_NAME);
         return false;
-    } 
-    
-    if ((varPropVal.vt != VT_I4) && (varPropVal.vt != VT_UI4)) {
-        return false; // variant type mismatch
     }
 
-    *Color = varPropVal.uintVal;
     return true;
 }
 
 bool Luminous::Set(COLORREF Color) {
-    // Get the property value.
-    CComVariant  varPropVal;
-    CIMTYPE     cimType = 0;
-    HRESULT hr = m_wbemClassObject->Get(
-                             CComBSTR(PROPERTY_NAME),
-                             0,
-                             &varPropVal,
-                             &cimType,
-                             NULL );
-
-    if (hr != WBEM_S_NO_ERROR ) {
-        _tprintf( TEXT("Error %lX: Failed to read property value of %s.\n"), hr, PROPERTY_NAME);
+    if (m_devices.size() == 1)
+        return Put(m_devices.begin()->second, Color); // nothing to overlap
+
+    // issue all writes before waiting, so that the broadcast takes about as long as the slowest device
+    auto latch = std::make_shared<CompletionLatch>(m_devices.size());
+    for (auto& entry : m_devices) {
+        HRESULT hr = PutAsync(entry.second, Color, [latch](HRESULT result) { latch->Complete(result); });
+        if (hr != WBEM_S_NO_ERROR)
+            latch->Complete(hr); // sink will not be called
+    }
+
+    HRESULT hr = latch->Wait();
+    if (hr != WBEM_S_NO_ERROR) {
+        _tprintf( TEXT("Error %lX: Failed to save the instances, %s will not be updated.\n"), hr, PROPERTY_NAME);
         return false;
     }
 
-    if ((varPropVal.vt != VT_I4) && (varPropVal.vt != VT_UI4)) {
-        return false; // variant type mismatch
+    return true;
+}
+
+bool Luminous::Set(const std::wstring& instanceName, COLORREF Color) {
+    auto it = m_devices.find(instanceName);
+    if (it == m_devices.end()) {
+        _tprintf(TEXT("Unknown instance %s.\n"), instanceName.c_str());
+        return false;
     }
 
-    varPropVal.uintVal = Color;
+    return Put(it->second, Color);
+}
+
+std::vector<std::wstring> Luminous::InstanceNames() const {
+    std::vector<std::wstring> names;
+    for (auto& entry : m_devices)
+        names.push_back(entry.first);
+    return names;
+}
 
-    // Set the property value
-    hr = m_wbemClassObject->Put(CComBSTR(PROPERTY_NAME), 0, &varPropVal, cimType);
+bool Luminous::Put(Device& device, COLORREF Color) {
+    // Set the property value and save the instance
+    HRESULT hr = device.writer->Put(Color);
 
     if (hr != WBEM_S_NO_ERROR) {
-        _tprintf(TEXT("Error %lX: Failed to set property value of %s.\n"), hr, PROPERTY_NAME);
+        _tprintf( TEXT("Error %lX: Failed to save the instance, %s will not be updated.\n"), hr, PROPERTY_NAME);
         return false;
     }
 
-    hr = m_wbemServices->PutInstance(m_wbemClassObject, WBEM_FLAG_UPDATE_ONLY, NULL, NULL);
+    return true;
+}
 
-    if (hr != WBEM_S_NO_ERROR) {
-        _tprintf( TEXT("Failed to save the instance, %s will not be updated.\n"), PROPERTY_NAME);
-        return false;
+HRESULT Luminous::PutAsync(Device& device, COLORREF Color, std::function<void(HRESULT)> onComplete) {
+    CComPtr<IWbemObjectSink> sink;
+    sink.Attach(new PutInstanceSink(std::move(onComplete)));
+    return device.writer->PutAsync(Color, sink);
+}
+
+bool Luminous::SetByName(COLORREF Color) {
+    for (auto& entry : m_devices) {
+        IWbemClassObject* wbemClassObject = entry.second.wbemClassObject;
+        if (!wbemClassObject)
+            return false; // not a WMI device
+
+        // Get the property value.
+        CComVariant  varPropVal;
+        CIMTYPE     cimType = 0;
+        HRESULT hr = wbemClassObject->Get(
+                                 CComBSTR(PROPERTY_NAME),
+                                 0,
+                                 &varPropVal,
+                                 &cimType,
+                                 NULL );
+
+        if (hr != WBEM_S_NO_ERROR ) {
+            _tprintf( TEXT("Error %lX: Failed to read property value of %s.\n"), hr, PROPERTY_NAME);
+            return false;
+        }
+
+        if ((varPropVal.vt != VT_I4) && (varPropVal.vt != VT_UI4)) {
+            return false; // variant type mismatch
+        }
+
+        varPropVal.uintVal = Color;
+
+        // Set the property value
+        hr = wbemClassObject->Put(CComBSTR(PROPERTY_NAME), 0, &varPropVal, cimType);
+
+        if (hr != WBEM_S_NO_ERROR) {
+            _tprintf(TEXT("Error %lX: Failed to set property value of %s.\n"), hr, PROPERTY_NAME);
+            return false;
+        }
+
+        hr = m_wbemServices->PutInstance(wbemClassObject, WBEM_FLAG_UPDATE_ONLY, NULL, NULL);
+
+        if (hr != WBEM_S_NO_ERROR) {
+            _tprintf( TEXT("Failed to save the instance, %s will not be updated.\n"), PROPERTY_NAME);
+            return false;
+        }
     }
-    
+
     return true;
 }
+
+
+void Luminous::SetAsync(COLORREF Color) {
+    if (!m_async) {
+        // the writer thread calls Set without initializing COM, and thereby joins the process MTA implicitly
+        m_asyncBackend = std::make_unique<WmiLightBackend>(*this);
+        m_async = std::make_unique<CoalescingWriter>(*m_asyncBackend);
+    }
+
+    m_async->Set(Color);
+}
+
+bool Luminous::Flush(DWORD timeoutMs) {
+    if (!m_async)
+        return true;
+
+    if (timeoutMs == INFINITE)
+        return m_async->Flush();
+    return m_async->Flush(std::chrono::milliseconds(timeoutMs));
+}
+
+Luminous::AsyncStats Luminous::GetAsyncStats() const {
+    if (!m_async)
+        return AsyncStats();
+
+    return m_async->GetStats();
+}
@@ -1,18 +1,105 @@
 #pragma once
+#include "CoalescingWriter.hpp"
 #include <atlbase.h>
 #include <windows.h>
 #include <wbemcli.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/** Write access to the tail-light property of one device.
+    Separates the provider round trip from Luminous, so that broadcasts can be benchmarked against mock devices. */
+class DeviceWriter {
+public:
+    virtual ~DeviceWriter() = default;
+
+    /** Read the current color. */
+    virtual HRESULT Read(COLORREF* Color) = 0;
+
+    /** Write color and wait for the provider to complete. */
+    virtual HRESULT Put(COLORREF Color) = 0;
+
+    /** Start writing color. On success, completion is reported through sink->SetStatus(WBEM_STATUS_COMPLETE, ...).
+        Must not be called again before the previous write has completed. */
+    virtual HRESULT PutAsync(COLORREF Color, IWbemObjectSink* sink) = 0;
+};
 
 
 class Luminous {
 public:
+    /** Statistics for asynchronous writes. */
+    using AsyncStats = CoalescingWriter::Stats;
+
+    /** Connect to the TailLight WMI provider and find all devices. */
     Luminous();
+    /** Use the given device writers, keyed by instance name, instead of WMI (for benchmarking). */
+    explicit Luminous(std::map<std::wstring, std::unique_ptr<DeviceWriter>> writers);
     ~Luminous();
 
+    /** Set color of all devices. The writes are issued concurrently, and the call returns when all have completed. */
     bool Set(COLORREF Color);
+    /** Get color of the first device. */
     bool Get(COLORREF*Color);
 
+    /** Set color of a single device, identified by its WMI instance name. */
+    bool Set(const std::wstring& instanceName, COLORREF Color);
+    bool Get(const std::wstring& instanceName, COLORREF* Color);
+
+    /** WMI instance names of the devices found on construction, in sorted order. */
+    std::vector<std::wstring> InstanceNames() const;
+
+    /** Reference implementation of Set through named property access and serial writes (for benchmarking). */
+    bool SetByName(COLORREF Color);
+
+    /** Queue color for asynchronous writes to all devices through a CoalescingWriter.
+        At most one color is in flight. A color queued while a write is in flight
+        replaces any older queued color, so that the latest color is always written next. */
+    void SetAsync(COLORREF Color);
+
+    /** Wait until all queued asynchronous writes have completed. Returns false on timeout. */
+    bool Flush(DWORD timeoutMs = INFINITE);
+
+    AsyncStats GetAsyncStats() const;
+
 private:
+    struct Device {
+        std::unique_ptr<DeviceWriter> writer;
+        CComPtr<IWbemClassObject> wbemClassObject; // TailLightDeviceInformation instance (for SetByName, null for mock devices)
+    };
+
+    bool Put(Device& device, COLORREF Color);
+    HRESULT PutAsync(Device& device, COLORREF Color, std::function<void(HRESULT)> onComplete);
+
     CComPtr<IWbemServices> m_wbemServices;
-    CComPtr<IWbemClassObject> m_wbemClassObject;
+    std::map<std::wstring, Device> m_devices; // keyed by InstanceName
+
+    std::unique_ptr<LightBackend>     m_asyncBackend; // broadcast Set of this object
+    std::unique_ptr<CoalescingWriter> m_async;
+};
+
+
+/** LightBackend adapter of Luminous, controlling the light through the driver WMI interface. */
+class WmiLightBackend : public LightBackend {
+public:
+    explicit WmiLightBackend(Luminous& luminous) : m_luminous(luminous) {
+    }
+
+    bool Set(uint32_t color) override {
+        return m_luminous.Set((COLORREF)color);
+    }
+
+    bool Get(uint32_t* color) override {
+        COLORREF value = 0;
+        if (!color || !m_luminous.Get(&value))
+            return false;
+
+        *color = value;
+        return true;
+    }
+
+private:
+    Luminous& m_luminous;
 };
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdio>
+
+
+/** Number of failed checks in this test program. */
+inline int& CheckFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+/** Report and count a failed condition. The test continues after a failure. */
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            CheckFailures()++; \
+        } \
+    } while (0)
+
+/** Print test result. Returns the process exit code. */
+inline int CheckResult(const char* name) {
+    printf("%s: %s\n", name, CheckFailures() ? "FAILED" : "passed");
+    return CheckFailures() ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/* Unit tests of the flicker latest-wins asynchronous writer, driven by the pattern scheduler against the mock backend. */
+#include "../flicker/CoalescingWriter.hpp"
+#include "Check.hpp"
+
+using namespace std::chrono_literals;
+
+
+static std::vector<PatternFrame> CountingPattern(unsigned int count, std::chrono::microseconds delay) {
+    std::vector<PatternFrame> frames;
+    for (unsigned int i = 0; i < count; i++)
+        frames.push_back({delay, i + 1});
+    return frames;
+}
+
+/** Written colors are a subsequence of the queued colors that ends with the last queued color. */
+static void CheckLatestWins(const std::vector<MockLightBackend::Event>& events, uint32_t last) {
+    CHECK(!events.empty());
+    for (size_t i = 1; i < events.size(); i++)
+        CHECK(events[i].color > events[i - 1].color);
+    CHECK(!events.empty() && (events.back().color == last));
+}
+
+/** Colors queued faster than they can be written are coalesced, and the last color is always written. */
+static void TestCoalescing() {
+    SystemClock backendClock;
+    MockLightBackend backend(backendClock, 2ms);
+    CoalescingWriter writer(backend);
+
+    FakeClock clock; // schedule instantly
+    PatternScheduler scheduler(clock);
+    CHECK(scheduler.Play(CountingPattern(1000, 1ms), [&writer](uint32_t color) {
+        writer.Set(color);
+        return true;
+    }));
+    CHECK(scheduler.Stats().late == 0); // queuing never blocks on the backend
+    CHECK(writer.Flush());
+
+    CoalescingWriter::Stats stats = writer.GetStats();
+    std::vector<MockLightBackend::Event> events = backend.Events();
+    CHECK(stats.queued == 1000);
+    CHECK(stats.completed == events.size());
+    CHECK(stats.failed == 0);
+    CHECK(stats.replaced > 0);
+    CHECK(stats.queued == stats.replaced + stats.completed + stats.failed);
+    CheckLatestWins(events, 1000);
+}
+
+/** Paced pattern with a backend slower than the frame period: stale colors are skipped instead of delaying later colors. */
+static void TestSlowBackend() {
+    SystemClock clock;
+    MockLightBackend backend(clock, 12ms);
+    CoalescingWriter writer(backend);
+
+    PatternScheduler scheduler(clock);
+    SchedulerClock::duration start = clock.Now();
+    CHECK(scheduler.Play(CountingPattern(40, 5ms), [&writer](uint32_t color) {
+        writer.Set(color);
+        return true;
+    }));
+    CHECK(writer.Flush());
+
+    CoalescingWriter::Stats stats = writer.GetStats();
+    std::vector<MockLightBackend::Event> events = backend.Events();
+    CHECK(stats.queued == 40);
+    CHECK(stats.replaced > 0);
+    CHECK(stats.queued == stats.replaced + stats.completed);
+    CheckLatestWins(events, 40);
+
+    // the last color follows the end of the pattern by at most two writes
+    CHECK(!events.empty() && (events.back().time - start <= 40 * 5ms + 2 * 12ms + 20ms));
+}
+
+/** Failed writes are counted, and later colors are still written. */
+static void TestFailure() {
+    FakeClock clock;
+    MockLightBackend backend(clock);
+    CoalescingWriter writer(backend);
+
+    backend.FailNext(1);
+    writer.Set(1);
+    CHECK(writer.Flush());
+    writer.Set(2);
+    CHECK(writer.Flush());
+
+    CoalescingWriter::Stats stats = writer.GetStats();
+    CHECK((stats.queued == 2) && (stats.failed == 1) && (stats.completed == 1));
+    uint32_t color = 0;
+    CHECK(backend.Get(&color) && (color == 2));
+}
+
+/** Flush times out while a write is in flight, and destruction discards a queued color. */
+static void TestFlushAndStop() {
+    SystemClock clock;
+    MockLightBackend backend(clock, 100ms);
+    {
+        CoalescingWriter writer(backend);
+        writer.Set(1);
+        CHECK(!writer.Flush(10ms));
+        CHECK(writer.Flush());
+
+        writer.Set(2);
+        std::this_thread::sleep_for(20ms); // let the write of 2 start
+        writer.Set(3);
+    }
+    std::vector<MockLightBackend::Event> events = backend.Events();
+    CHECK(events.size() == 2);
+    CHECK(!events.empty() && (events.back().color == 2)); // in-flight write completed, 3 discarded
+}
+
+
+int main() {
+    TestCoalescing();
+    TestSlowBackend();
+    TestFailure();
+    TestFlushAndStop();
+    return CheckResult("CoalescingWriterTest");
+}
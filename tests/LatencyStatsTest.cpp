@@ -0,0 +1,103 @@
+/* Unit tests of the HidUtil latency statistics and benchmark report output. */
+#include "../HidUtil/Stats.hpp"
+#include "Check.hpp"
+#include <cstdlib>
+#include <cstring>
+
+
+static bool Near(double a, double b) {
+    return std::fabs(a - b) < 1e-9;
+}
+
+static void TestEmpty() {
+    LatencyStats stats;
+    CHECK(stats.Count() == 0);
+    CHECK(stats.Min() == 0);
+    CHECK(stats.Max() == 0);
+    CHECK(stats.Mean() == 0);
+    CHECK(stats.StdDev() == 0);
+    CHECK(stats.Percentile(50) == 0);
+}
+
+static void TestSummary() {
+    LatencyStats stats;
+    const double samples[] = {40, 10, 30, 20, 50}; // unsorted
+    for (double s : samples)
+        stats.Add(s);
+
+    CHECK(stats.Count() == 5);
+    CHECK(Near(stats.Min(), 10));
+    CHECK(Near(stats.Max(), 50));
+    CHECK(Near(stats.Mean(), 30));
+    CHECK(Near(stats.StdDev(), std::sqrt(250.0))); // sample standard deviation
+    CHECK(Near(stats.Percentile(0), 10));
+    CHECK(Near(stats.Percentile(50), 30));
+    CHECK(Near(stats.Percentile(100), 50));
+    CHECK(Near(stats.Percentile(90), 46)); // interpolated between 40 and 50
+    CHECK(Near(stats.Percentile(12.5), 15));
+
+    // samples added after sorting are included
+    stats.Add(5);
+    CHECK(Near(stats.Min(), 5));
+    stats.Add(100);
+    CHECK(Near(stats.Max(), 100));
+    CHECK(Near(stats.Percentile(50), 30));
+
+    LatencyStats single;
+    single.Add(7);
+    CHECK(Near(single.Percentile(99.9), 7));
+    CHECK(single.StdDev() == 0);
+}
+
+static void TestMeasure() {
+    int calls = 0;
+    size_t failures = 0;
+    LatencyStats stats = Measure(10, 100, failures, [&calls] {
+        calls++;
+        return (calls % 4) != 0; // every 4th call fails
+    });
+    CHECK(calls == 110);
+    CHECK(failures == 25); // calls 12, 16, ..., 108 of the measured ones
+    CHECK(stats.Count() == 75);
+    CHECK(stats.Min() >= 0);
+}
+
+/** JSON report contains all results, and device names are escaped. */
+static void TestJson() {
+    BenchConfig config;
+    config.iterations = 3;
+    config.cpu = 2;
+
+    std::vector<BenchResult> results;
+    results.push_back({"dev\"1\\", "SetFeature", LatencyStats(), 1});
+    results.back().stats.Add(100);
+    results.back().stats.Add(200);
+    results.push_back({"dev2", "GetFeature", LatencyStats(), 0});
+
+    char* buffer = nullptr;
+    size_t size = 0;
+    FILE* out = open_memstream(&buffer, &size);
+    WriteBenchJson(out, config, results);
+    fclose(out);
+
+    std::string json(buffer, size);
+    free(buffer);
+    CHECK(json.find("\"iterations\": 3,") != std::string::npos);
+    CHECK(json.find("\"cpu\": 2,") != std::string::npos);
+    CHECK(json.find("\"device\": \"dev\\\"1\\\\\"") != std::string::npos);
+    CHECK(json.find("\"samples\": 2, \"failures\": 1") != std::string::npos);
+    CHECK(json.find("\"p50\": 150.000") != std::string::npos);
+    CHECK(json.find("\"p99.9\"") != std::string::npos);
+    CHECK(json.find("\"device\": \"dev2\", \"operation\": \"GetFeature\", \"samples\": 0") != std::string::npos);
+    CHECK(json.find("}},\n") != std::string::npos); // separator between results
+    CHECK(json.rfind("}}\n  ]\n}\n") == json.size() - 9); // no trailing separator
+}
+
+
+int main() {
+    TestEmpty();
+    TestSummary();
+    TestMeasure();
+    TestJson();
+    return CheckResult("LatencyStatsTest");
+}
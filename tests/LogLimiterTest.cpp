@@ -0,0 +1,138 @@
+/* Unit tests of the TailLight safety log limiter under flood load. */
+#include "../TailLight/LogLimiter.hpp"
+#include "Check.hpp"
+#include <vector>
+
+
+/** 100ns units per millisecond. */
+static constexpr unsigned long long MS = 10 * 1000;
+
+
+/** Drives LogLimiter the same way as the driver, with a one-shot flush timer. */
+class LogSimulator {
+public:
+    void Record(unsigned long long now, unsigned int color, unsigned int saturation) {
+        RunTimer(now);
+        Handle(now, m_limiter.Record(now, color, saturation));
+    }
+
+    /** Fire the flush timer if due. */
+    void RunTimer(unsigned long long now) {
+        if (m_timerPending && (now >= m_timerDue)) {
+            m_timerPending = false;
+            Handle(now, m_limiter.Flush(now));
+        }
+    }
+
+    std::vector<LogLimiter::Summary> entries;
+    std::vector<unsigned long long>  times; // time of each entry
+
+private:
+    void Handle(unsigned long long now, LogLimiter::Action action) {
+        if (action == LogLimiter::Emit) {
+            entries.push_back(m_limiter.Take());
+            times.push_back(now);
+        } else if (action == LogLimiter::Schedule) {
+            CHECK(!m_timerPending); // only one flush outstanding
+            m_timerPending = true;
+            m_timerDue = now + m_limiter.Delay(now);
+        }
+    }
+
+    LogLimiter         m_limiter;
+    bool               m_timerPending = false;
+    unsigned long long m_timerDue = 0;
+};
+
+
+/** A 10 kHz flood for 60 s is logged as a small burst followed by one entry per interval, without losing events. */
+static void TestFlood() {
+    const unsigned long long start = 3600ull * 1000 * MS; // an hour after boot
+    const unsigned long long duration = 60ull * 1000 * MS;
+    const unsigned long long step = MS / 10;
+
+    LogSimulator sim;
+    unsigned int events = 0;
+    unsigned long long now = start;
+    for (; now < start + duration; now += step) {
+        unsigned int color = events & 0xFFFFFF;
+        sim.Record(now, color, 400 + (events % 300));
+        events++;
+    }
+    unsigned int lastColor = (events - 1) & 0xFFFFFF;
+
+    // let the pending flush fire
+    now += LogLimiter::INTERVAL;
+    sim.RunTimer(now);
+
+    const size_t maxEntries = LogLimiter::BUCKET_SIZE + duration / LogLimiter::INTERVAL + 1;
+    CHECK(sim.entries.size() <= maxEntries);
+    CHECK(sim.entries.size() >= duration / LogLimiter::INTERVAL);
+
+    // all events are accounted for, in order
+    unsigned long long total = 0;
+    unsigned int worst = 0;
+    for (const LogLimiter::Summary& entry : sim.entries) {
+        total += entry.Count;
+        if (entry.WorstSaturation > worst)
+            worst = entry.WorstSaturation;
+    }
+    CHECK(total == events);
+    CHECK(worst == 699);
+    CHECK(!sim.entries.empty() && (sim.entries.front().FirstColor == 0));
+    CHECK(!sim.entries.empty() && (sim.entries.back().LastColor == lastColor));
+
+    // after the burst, entries are at least an interval apart
+    for (size_t i = LogLimiter::BUCKET_SIZE + 1; i < sim.times.size(); i++)
+        CHECK(sim.times[i] - sim.times[i - 1] >= LogLimiter::INTERVAL);
+}
+
+/** Sporadic events are logged immediately, and the burst is available again after a quiet period. */
+static void TestSporadic() {
+    LogSimulator sim;
+    unsigned long long now = 3600ull * 1000 * MS;
+    for (unsigned int i = 0; i < LogLimiter::BUCKET_SIZE; i++)
+        sim.Record(now + i * MS, 0x0000FF, 500 + i);
+    CHECK(sim.entries.size() == LogLimiter::BUCKET_SIZE);
+    for (const LogLimiter::Summary& entry : sim.entries)
+        CHECK(entry.Count == 1);
+
+    now += LogLimiter::BUCKET_SIZE * LogLimiter::INTERVAL + 100 * MS;
+    sim.entries.clear();
+    for (unsigned int i = 0; i < LogLimiter::BUCKET_SIZE; i++)
+        sim.Record(now + i * MS, 0x00FF00, 500);
+    CHECK(sim.entries.size() == LogLimiter::BUCKET_SIZE);
+}
+
+/** Summary tracks first/last color and the worst saturation. */
+static void TestAggregation() {
+    LogLimiter limiter;
+    unsigned long long now = 3600ull * 1000 * MS;
+    for (unsigned int i = 0; i < LogLimiter::BUCKET_SIZE; i++) {
+        CHECK(limiter.Record(now, 1, 500) == LogLimiter::Emit);
+        limiter.Take();
+    }
+
+    CHECK(limiter.Record(now, 0x111111, 600) == LogLimiter::Schedule);
+    CHECK(limiter.Record(now + 1, 0x222222, 700) == LogLimiter::None);
+    CHECK(limiter.Record(now + 2, 0x333333, 650) == LogLimiter::None);
+    CHECK(limiter.Delay(now + 2) > 0);
+
+    CHECK(limiter.Flush(now + LogLimiter::INTERVAL) == LogLimiter::Emit);
+    LogLimiter::Summary summary = limiter.Take();
+    CHECK(summary.Count == 3);
+    CHECK(summary.FirstColor == 0x111111);
+    CHECK(summary.LastColor == 0x333333);
+    CHECK(summary.WorstSaturation == 700);
+
+    // nothing left to flush
+    CHECK(limiter.Flush(now + 2 * LogLimiter::INTERVAL) == LogLimiter::None);
+}
+
+
+int main() {
+    TestFlood();
+    TestSporadic();
+    TestAggregation();
+    return CheckResult("LogLimiterTest");
+}
@@ -0,0 +1,166 @@
+/* Unit tests of the flicker pattern scheduler with a deterministic clock. */
+#include "../flicker/LightBackend.hpp"
+#include "Check.hpp"
+#include <pthread.h>
+#include <signal.h>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+
+static std::vector<PatternFrame> EvenPattern(unsigned int count, std::chrono::microseconds delay) {
+    std::vector<PatternFrame> frames;
+    for (unsigned int i = 0; i < count; i++)
+        frames.push_back({delay, i});
+    return frames;
+}
+
+/** Without Set latency, every color is set exactly at its deadline. */
+static void TestDeadlines() {
+    FakeClock clock;
+    clock.Advance(5s); // arbitrary epoch
+    MockLightBackend backend(clock);
+    PatternScheduler scheduler(clock);
+
+    std::vector<PatternFrame> frames = {{0ms, 1}, {500ms, 2}, {12ms, 3}, {0ms, 4}, {100ms, 5}};
+    CHECK(scheduler.Play(frames, [&backend](uint32_t color) { return backend.Set(color); }));
+
+    std::vector<MockLightBackend::Event> events = backend.Events();
+    const SchedulerClock::duration expected[] = {5000ms, 5500ms, 5512ms, 5512ms, 5612ms};
+    CHECK(events.size() == 5);
+    for (size_t i = 0; (i < events.size()) && (i < 5); i++) {
+        CHECK(events[i].time == expected[i]);
+        CHECK(events[i].color == i + 1);
+    }
+
+    FrameTimingStats stats = scheduler.Stats();
+    CHECK(stats.frames == 5);
+    CHECK((stats.late == 0) && (stats.mean == 0) && (stats.min == 0) && (stats.max == 0) && (stats.stdDev == 0));
+}
+
+/** Constant Set latency is learned from the first frame and compensated by issuing later frames early. */
+static void TestLatencyCompensation() {
+    FakeClock clock;
+    MockLightBackend backend(clock, 2ms);
+    PatternScheduler scheduler(clock);
+
+    CHECK(scheduler.Play(EvenPattern(5, 10ms), [&backend](uint32_t color) { return backend.Set(color); }));
+    std::vector<MockLightBackend::Event> events = backend.Events();
+    CHECK(events.size() == 5);
+    if (events.size() == 5) {
+        CHECK(events[0].time == 12ms); // first frame late by the unknown latency
+        for (size_t i = 1; i < events.size(); i++)
+            CHECK(events[i].time == (i + 1) * 10ms);
+    }
+
+    FrameTimingStats stats = scheduler.Stats();
+    CHECK(stats.frames == 5);
+    CHECK(stats.late == 1);
+    CHECK(stats.max == 2000);
+    CHECK(stats.min == 0);
+    CHECK(stats.mean == 400);
+    CHECK(stats.setLatency == 2000);
+
+    // the estimate is kept for the next pattern, so that its first frame is on time
+    SchedulerClock::duration start = clock.Now();
+    CHECK(scheduler.Play(EvenPattern(3, 10ms), [&backend](uint32_t color) { return backend.Set(color); }));
+    events = backend.Events();
+    CHECK((events.size() == 8) && (events[5].time == start + 10ms));
+    CHECK(scheduler.Stats().late == 0);
+}
+
+/** Latency changes are tracked gradually, and late frames don't shift later deadlines. */
+static void TestLatencyChange() {
+    FakeClock clock;
+    SchedulerClock::duration latency = 1ms;
+    PatternScheduler scheduler(clock);
+    std::vector<SchedulerClock::duration> times;
+    auto set = [&](uint32_t) {
+        clock.Advance(latency);
+        times.push_back(clock.Now());
+        return true;
+    };
+
+    CHECK(scheduler.Play(EvenPattern(4, 10ms), set));
+    latency = 5ms;
+    SchedulerClock::duration start = clock.Now();
+    CHECK(scheduler.Play(EvenPattern(40, 10ms), set));
+    CHECK(times.size() == 44);
+
+    // error shrinks as the estimate converges on the new latency
+    double prevError = 1e9;
+    for (size_t i = 4; i < times.size(); i++) {
+        double error = std::chrono::duration<double, std::micro>(times[i] - (start + (i - 3) * 10ms)).count();
+        CHECK(error >= 0);
+        CHECK(error <= 4000);
+        CHECK(error <= prevError);
+        prevError = error;
+    }
+    CHECK(prevError < 50);
+    CHECK(std::fabs(scheduler.Stats().setLatency - 5000) < 50);
+
+    // Set slower than the frame period: frames are late and issued back to back, without sleeping in between
+    latency = 25ms;
+    times.clear();
+    start = clock.Now();
+    CHECK(scheduler.Play(EvenPattern(10, 10ms), set));
+    CHECK(times.size() == 10);
+    CHECK(scheduler.Stats().late >= 9);
+    for (size_t i = 1; i < times.size(); i++)
+        CHECK(times[i] - times[i - 1] == latency);
+}
+
+/** A failing Set aborts playback. */
+static void TestFailure() {
+    FakeClock clock;
+    MockLightBackend backend(clock);
+    PatternScheduler scheduler(clock);
+
+    unsigned int calls = 0;
+    CHECK(!scheduler.Play(EvenPattern(5, 1ms), [&](uint32_t color) {
+        if (++calls == 3)
+            backend.FailNext(1);
+        return backend.Set(color);
+    }));
+    CHECK(calls == 3);
+    CHECK(backend.Events().size() == 2);
+    CHECK(scheduler.Stats().frames == 2);
+}
+
+static void OnSignal(int) {
+}
+
+/** SystemClock sleeps until the absolute deadline, also when interrupted by a signal. */
+static void TestSystemClock() {
+    SystemClock clock;
+    SchedulerClock::duration deadline = clock.Now() + 20ms;
+    clock.SleepUntil(deadline);
+    CHECK(clock.Now() >= deadline);
+
+    struct sigaction action = {};
+    action.sa_handler = OnSignal; // without SA_RESTART, so that clock_nanosleep returns EINTR
+    sigaction(SIGUSR1, &action, nullptr);
+    pthread_t sleeper = pthread_self();
+    std::thread interrupter([sleeper] {
+        std::this_thread::sleep_for(5ms);
+        pthread_kill(sleeper, SIGUSR1);
+    });
+    deadline = clock.Now() + 50ms;
+    clock.SleepUntil(deadline);
+    CHECK(clock.Now() >= deadline);
+    interrupter.join();
+
+    SchedulerClock::duration now = clock.Now();
+    clock.SleepUntil(now - 1s); // past deadline returns immediately
+    CHECK(clock.Now() - now < 10ms);
+}
+
+
+int main() {
+    TestDeadlines();
+    TestLatencyCompensation();
+    TestLatencyChange();
+    TestFailure();
+    TestSystemClock();
+    return CheckResult("PatternSchedulerTest");
+}
@@ -0,0 +1,116 @@
+/* Benchmark of the TailLight size-class pool allocator built as a user-mode library.
+   Compares PoolAllocate/PoolFree (size-class lookup and per-tag accounting) against plain malloc/free,
+   and checks that the accounting balances after single- and multi-threaded churn. */
+#include "../TailLight/PoolAllocator.cpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+/** Allocation sizes mirroring driver usage: mostly preparsed data and small objects, occasionally large buffers. */
+static std::vector<size_t> MakeSizes(size_t count, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::vector<size_t> sizes(count);
+    for (size_t& size : sizes) {
+        unsigned int r = rng() % 100;
+        if (r < 60)
+            size = 16 + rng() % 48;    // class 0
+        else if (r < 85)
+            size = 64 + rng() % 192;   // class 1 (preparsed data)
+        else if (r < 95)
+            size = 256 + rng() % 768;  // class 2
+        else if (r < 99)
+            size = 1024 + rng() % 3072; // class 3
+        else
+            size = 4096 + rng() % 8192; // non-pooled
+    }
+    return sizes;
+}
+
+/** Allocate and free with up to "live" outstanding blocks. Returns ns per allocate+free pair. */
+template <class Alloc, class Free>
+static double Churn(const std::vector<size_t>& sizes, size_t live, Alloc alloc, Free free) {
+    std::vector<void*> slots(live, nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sizes.size(); i++) {
+        void*& slot = slots[i % live];
+        free(slot);
+        slot = alloc(sizes[i]);
+        static_cast<char*>(slot)[0] = 1; // touch block
+    }
+    for (void*& slot : slots) {
+        free(slot);
+        slot = nullptr;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / sizes.size();
+}
+
+static double ChurnPool(const std::vector<size_t>& sizes, size_t live) {
+    return Churn(sizes, live, PoolAllocate, PoolFree);
+}
+
+static double ChurnMalloc(const std::vector<size_t>& sizes, size_t live) {
+    return Churn(sizes, live, malloc, free);
+}
+
+static bool Balanced() {
+    PoolClassStatistics stats[POOL_CLASS_COUNT] = {};
+    PoolGetStatistics(stats);
+    for (const PoolClassStatistics& s : stats) {
+        if (s.Outstanding != 0)
+            return false;
+    }
+    return true;
+}
+
+
+int main() {
+    const size_t COUNT = 5 * 1000 * 1000;
+    const size_t LIVE = 64;
+    const unsigned int THREADS = 4;
+
+    if (!PoolInitialize())
+        return 1;
+
+    std::vector<size_t> sizes = MakeSizes(COUNT, 1234);
+    printf("PoolAllocatorBench: single thread, %zu allocations, %zu live\n", COUNT, LIVE);
+    printf("  malloc/free:         %6.1f ns/pair\n", ChurnMalloc(sizes, LIVE));
+    printf("  PoolAllocate/Free:   %6.1f ns/pair\n", ChurnPool(sizes, LIVE));
+
+    // concurrent churn contends on the shared accounting counters
+    for (int pool = 0; pool < 2; pool++) {
+        std::vector<std::thread> threads;
+        std::vector<double> results(THREADS);
+        for (unsigned int t = 0; t < THREADS; t++) {
+            threads.emplace_back([&, t]() {
+                std::vector<size_t> threadSizes = MakeSizes(COUNT / THREADS, 100 + t);
+                results[t] = pool ? ChurnPool(threadSizes, LIVE) : ChurnMalloc(threadSizes, LIVE);
+            });
+        }
+        double sum = 0;
+        for (unsigned int t = 0; t < THREADS; t++) {
+            threads[t].join();
+            sum += results[t];
+        }
+        printf("  %s %u threads: %6.1f ns/pair\n", pool ? "PoolAllocate/Free" : "malloc/free      ", THREADS, sum / THREADS);
+    }
+
+    PoolClassStatistics stats[POOL_CLASS_COUNT] = {};
+    PoolGetStatistics(stats);
+    printf("  %-8s %10s %12s %11s %9s\n", "tag", "block size", "allocations", "outstanding", "highwater");
+    for (const PoolClassStatistics& s : stats) {
+        char tag[5] = {(char)(s.Tag & 0xFF), (char)((s.Tag >> 8) & 0xFF), (char)((s.Tag >> 16) & 0xFF), (char)(s.Tag >> 24), 0};
+        printf("  %-8s %10u %12u %11u %9u\n", tag, s.BlockSize, s.Allocations, s.Outstanding, s.HighWater);
+    }
+
+    bool balanced = Balanced();
+    PoolCleanup();
+    if (!balanced) {
+        printf("ERROR: Outstanding allocations after benchmark.\n");
+        return 1;
+    }
+    return 0;
+}
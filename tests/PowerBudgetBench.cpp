@@ -0,0 +1,35 @@
+/* Benchmark of the TailLight power model evaluated per feature write. */
+#include "../TailLight/PowerBudget.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+
+int main() {
+    const size_t COUNT = 20 * 1000 * 1000;
+
+    // long random color stream with jittered 1-20 ms frame intervals
+    std::mt19937 rng(1234);
+    std::vector<unsigned char> colors(3 * COUNT);
+    for (unsigned char& c : colors)
+        c = (unsigned char)rng();
+    std::vector<unsigned int> intervals(COUNT);
+    for (unsigned int& dt : intervals)
+        dt = 10 * 1000 * (1 + rng() % 20);
+
+    PowerBudget budget;
+    unsigned long long now = 0;
+    size_t reduced = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < COUNT; i++) {
+        now += intervals[i];
+        if (!budget.Apply(now, colors[3 * i], colors[3 * i + 1], colors[3 * i + 2]))
+            reduced++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("PowerBudgetBench: %zu frames in %.3f s (%.1f ns/frame, %zu reduced, average %u)\n",
+        COUNT, seconds, seconds * 1e9 / COUNT, reduced, budget.Average());
+    return 0;
+}
@@ -0,0 +1,102 @@
+/* Unit tests of the TailLight power model against long color streams. */
+#include "../TailLight/PowerBudget.hpp"
+#include "Check.hpp"
+#include <cstdlib>
+
+
+/** 100ns units per millisecond. */
+static constexpr unsigned long long MS = 10 * 1000;
+
+
+static unsigned int Sum(unsigned char r, unsigned char g, unsigned char b) {
+    return r + g + b;
+}
+
+/** Single frames below the peak limit pass unchanged. */
+static void TestSingleFrame() {
+    PowerBudget budget; // valid when zero-initialized
+    unsigned char r = 200, g = 200, b = 200;
+    CHECK(budget.Apply(1 * MS, r, g, b));
+    CHECK((r == 200) && (g == 200) && (b == 200));
+}
+
+/** Frames above the peak limit are scaled proportionally instead of clamped to red. */
+static void TestPeakScaling() {
+    PowerBudget budget;
+    unsigned char r = 255, g = 255, b = 200;
+    CHECK(!budget.Apply(1 * MS, r, g, b));
+    CHECK(Sum(r, g, b) <= PowerBudget::PEAK_LIMIT);
+    CHECK(Sum(r, g, b) + 3 >= PowerBudget::PEAK_LIMIT);
+    CHECK(r == g); // equal channels stay equal
+    CHECK(abs(255 * b - 200 * r) <= 255); // blue/red ratio preserved (not flipped to red)
+}
+
+/** A continuous white stream converges on the sustained limit without exceeding the peak limit or stepping abruptly. */
+static void TestSustainedStream() {
+    PowerBudget budget;
+    unsigned int prevSum = PowerBudget::PEAK_LIMIT;
+    unsigned int maxStep = 0;
+    unsigned int sum = 0;
+    for (unsigned long long t = 10 * MS; t <= 120 * 1000 * MS; t += 10 * MS) { // 100 Hz for 2 minutes
+        unsigned char r = 255, g = 255, b = 255;
+        budget.Apply(t, r, g, b);
+        sum = Sum(r, g, b);
+        CHECK(sum <= PowerBudget::PEAK_LIMIT);
+        if ((prevSum > sum) && (prevSum - sum > maxStep))
+            maxStep = prevSum - sum;
+        prevSum = sum;
+    }
+    CHECK(budget.Average() <= PowerBudget::SUSTAINED_LIMIT + 3);
+    CHECK(budget.Average() + 10 >= PowerBudget::SUSTAINED_LIMIT);
+    CHECK(sum + 10 >= PowerBudget::SUSTAINED_LIMIT);
+    CHECK(maxStep <= 3); // gradual ramp-down
+}
+
+/** The budget recovers after a dark period. */
+static void TestRecovery() {
+    PowerBudget budget;
+    unsigned long long t = 0;
+    for (int i = 0; i < 60 * 100; i++) { // 60 s white at 100 Hz
+        t += 10 * MS;
+        unsigned char r = 255, g = 255, b = 255;
+        budget.Apply(t, r, g, b);
+    }
+    CHECK(budget.Average() > PowerBudget::SUSTAINED_LIMIT / 2);
+
+    unsigned char r = 0, g = 0, b = 0;
+    for (int i = 0; i < 60 * 100; i++) { // 60 s dark at 100 Hz
+        t += 10 * MS;
+        r = g = b = 0;
+        budget.Apply(t, r, g, b);
+    }
+
+    t += 10 * MS;
+    r = 210; g = 210; b = 210;
+    CHECK(budget.Apply(t, r, g, b));
+    CHECK(Sum(r, g, b) == 630);
+}
+
+/** Timestamps going backwards or jumping far ahead don't break the model. */
+static void TestTimestamps() {
+    PowerBudget budget;
+    unsigned char r = 255, g = 255, b = 255;
+    budget.Apply(1000 * MS, r, g, b);
+    r = g = b = 255;
+    budget.Apply(500 * MS, r, g, b); // backwards: zero elapsed time
+    CHECK(Sum(r, g, b) <= PowerBudget::PEAK_LIMIT);
+
+    r = g = b = 255;
+    budget.Apply(~0ull / 2, r, g, b); // far ahead: fully converged on previous frame
+    CHECK(Sum(r, g, b) >= PowerBudget::SUSTAINED_LIMIT - 3);
+    CHECK(budget.Average() <= PowerBudget::PEAK_LIMIT);
+}
+
+
+int main() {
+    TestSingleFrame();
+    TestPeakScaling();
+    TestSustainedStream();
+    TestRecovery();
+    TestTimestamps();
+    return CheckResult("PowerBudgetTest");
+}
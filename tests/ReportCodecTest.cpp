@@ -0,0 +1,189 @@
+/* Unit tests of the HidUtil report descriptor parser, field encoding and tail-light report layout. */
+#include "../HidUtil/TailLightLayout.hpp"
+#include "Check.hpp"
+
+
+/** Mouse with 5 buttons, 16-bit X/Y and 8-bit wheel (no report ID). */
+static const uint8_t MOUSE_DESC[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01,             // Usage Page (Generic Desktop), Usage (Mouse), Collection (Application)
+    0x09, 0x01, 0xA1, 0x00,                         //   Usage (Pointer), Collection (Physical)
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x05,             //     Usage Page (Button), Usage Minimum (1), Usage Maximum (5)
+    0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, //     Logical Minimum (0), Logical Maximum (1), Report Count (5), Report Size (1)
+    0x81, 0x02,                                     //     Input (Data, Variable, Absolute)
+    0x95, 0x01, 0x75, 0x03, 0x81, 0x01,             //     Report Count (1), Report Size (3), Input (Constant)
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31,             //     Usage Page (Generic Desktop), Usage (X), Usage (Y)
+    0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F,             //     Logical Minimum (-32767), Logical Maximum (32767)
+    0x75, 0x10, 0x95, 0x02, 0x81, 0x06,             //     Report Size (16), Report Count (2), Input (Data, Variable, Relative)
+    0x09, 0x38, 0x15, 0x81, 0x25, 0x7F,             //     Usage (Wheel), Logical Minimum (-127), Logical Maximum (127)
+    0x75, 0x08, 0x95, 0x01, 0x81, 0x06,             //     Report Size (8), Report Count (1), Input (Data, Variable, Relative)
+    0xC0, 0xC0,                                     //   End Collection, End Collection
+};
+
+/** Vendor-defined tail-light feature report 0x24 described as a 72 byte array. */
+static const uint8_t TAILLIGHT_DESC[] = {
+    0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01, // Usage Page (Vendor 0xFF00), Usage (1), Collection (Application)
+    0x85, 0x24, 0x09, 0x02,                   //   Report ID (36), Usage (2)
+    0x15, 0x00, 0x26, 0xFF, 0x00,             //   Logical Minimum (0), Logical Maximum (255)
+    0x75, 0x08, 0x95, 0x48, 0xB1, 0x02,       //   Report Size (8), Report Count (72), Feature (Data, Variable, Absolute)
+    0xC0,                                     // End Collection
+};
+
+/** Same report length, but described as 16-bit words, so that the color bytes can't be located. */
+static const uint8_t TAILLIGHT_WORDS_DESC[] = {
+    0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01,
+    0x85, 0x24, 0x09, 0x02,
+    0x15, 0x00, 0x27, 0xFF, 0xFF, 0x00, 0x00, // Logical Maximum (65535)
+    0x75, 0x10, 0x95, 0x24, 0xB1, 0x02,       // Report Size (16), Report Count (36), Feature (Data, Variable, Absolute)
+    0xC0,
+};
+
+
+static void TestParseMouse() {
+    ReportCodec codec;
+    CHECK(codec.Parse(MOUSE_DESC, sizeof(MOUSE_DESC)));
+    CHECK(codec.HasCollection(0x01, 0x02));
+    CHECK(!codec.HasCollection(0x0C, 0x01));
+    CHECK(codec.ReportLength(ReportKind::Input) == 7); // report ID byte + 6
+    CHECK(codec.ReportLength(ReportKind::Feature) == 0);
+
+    ReportCaps caps = codec.Caps();
+    CHECK((caps.UsagePage == 0x01) && (caps.Usage == 0x02));
+    CHECK(caps.InputReportByteLength == 7);
+    CHECK(caps.NumberInputButtonCaps == 1);
+    CHECK(caps.NumberInputValueCaps == 3); // X, Y and wheel
+
+    unsigned int index = 0;
+    const ReportField* button = codec.Find(ReportKind::Input, 0, 0x09, 3, &index);
+    CHECK(button && button->isRange && (button->count == 5) && (button->bitSize == 1) && (button->bitOffset == 8));
+    CHECK(index == 2);
+    CHECK(!codec.Find(ReportKind::Input, 0, 0x09, 6));
+
+    const ReportField* x = codec.Find(ReportKind::Input, 0, 0x01, 0x30);
+    const ReportField* y = codec.Find(ReportKind::Input, 0, 0x01, 0x31);
+    const ReportField* wheel = codec.Find(ReportKind::Input, 0, 0x01, 0x38);
+    CHECK(x && (x->bitOffset == 16) && (x->bitSize == 16) && (x->logicalMin == -32767));
+    CHECK(y && (y->bitOffset == 32));
+    CHECK(wheel && (wheel->bitOffset == 48) && (wheel->bitSize == 8) && (wheel->logicalMin == -127));
+    CHECK(codec.FindAt(ReportKind::Input, 0, 32) == y);
+    CHECK(!codec.FindAt(ReportKind::Input, 0, 40)); // inside Y
+
+    // decode a report with button 1 and 3, X=-2, Y=300, wheel=-1
+    const uint8_t report[7] = {0x00, 0x05, 0xFE, 0xFF, 0x2C, 0x01, 0xFF};
+    if (button && x && y && wheel) {
+        CHECK(ReportCodec::Decode(*button, 0, report) == 1);
+        CHECK(ReportCodec::Decode(*button, 1, report) == 0);
+        CHECK(ReportCodec::Decode(*button, 2, report) == 1);
+        CHECK(ReportCodec::DecodeSigned(*x, 0, report) == -2);
+        CHECK(ReportCodec::DecodeSigned(*y, 0, report) == 300);
+        CHECK(ReportCodec::DecodeSigned(*wheel, 0, report) == -1);
+        CHECK(ReportCodec::Decode(*wheel, 0, report) == 0xFF);
+    }
+}
+
+/** Global push/pop and long items are handled, and malformed descriptors are rejected. */
+static void TestParseItems() {
+    const uint8_t pushPop[] = {
+        0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, // Usage Page (Consumer), Usage (1), Collection (Application)
+        0x75, 0x04, 0x95, 0x01, 0xA4,       //   Report Size (4), Report Count (1), Push
+        0x75, 0x0C, 0x09, 0xE0, 0x81, 0x02, //   Report Size (12), Usage (Volume), Input
+        0xB4, 0x09, 0xE2, 0x81, 0x02,       //   Pop, Usage (Mute), Input (4 bits again)
+        0xFE, 0x02, 0x10, 0xAA, 0xBB,       //   long item
+        0xC0,
+    };
+    ReportCodec codec;
+    CHECK(codec.Parse(pushPop, sizeof(pushPop)));
+    const ReportField* volume = codec.Find(ReportKind::Input, 0, 0x0C, 0xE0);
+    const ReportField* mute = codec.Find(ReportKind::Input, 0, 0x0C, 0xE2);
+    CHECK(volume && (volume->bitSize == 12) && (volume->bitOffset == 8));
+    CHECK(mute && (mute->bitSize == 4) && (mute->bitOffset == 20));
+    CHECK(codec.ReportLength(ReportKind::Input) == 3);
+
+    const uint8_t truncated[] = {0x05, 0x01, 0x09};
+    CHECK(!codec.Parse(truncated, sizeof(truncated)));
+    const uint8_t unbalanced[] = {0x05, 0x01, 0x09, 0x02, 0xC0};
+    CHECK(!codec.Parse(unbalanced, sizeof(unbalanced)));
+    const uint8_t unclosed[] = {0x05, 0x01, 0x09, 0x02, 0xA1, 0x01};
+    CHECK(!codec.Parse(unclosed, sizeof(unclosed)));
+    const uint8_t popEmpty[] = {0xB4};
+    CHECK(!codec.Parse(popEmpty, sizeof(popEmpty)));
+}
+
+/** Unaligned encoding only touches the bits of the element. */
+static void TestEncodeUnaligned() {
+    ReportField field;
+    field.bitSize = 12;
+    field.bitOffset = 11;
+    field.count = 2;
+
+    uint8_t report[6] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
+    ReportCodec::Encode(field, 0, 0xABC, report);
+    ReportCodec::Encode(field, 1, 0x123, report);
+    CHECK(ReportCodec::Decode(field, 0, report) == 0xABC);
+    CHECK(ReportCodec::Decode(field, 1, report) == 0x123);
+    CHECK(report[0] == 0xAA);
+    CHECK((report[1] & 0x07) == (0xAA & 0x07)); // bits 8-10
+    CHECK((report[4] & 0xF8) == (0xAA & 0xF8)); // bits 35-39
+    CHECK(report[5] == 0xAA);
+
+    ReportCodec::Encode(field, 0, 0xFFFFF, report); // excess bits are masked
+    CHECK(ReportCodec::Decode(field, 0, report) == 0xFFF);
+    CHECK(ReportCodec::Decode(field, 1, report) == 0x123);
+}
+
+static void CheckTailLightReport(const TailLightLayout& layout, uint8_t red, uint8_t green, uint8_t blue) {
+    const std::vector<uint8_t>& report = layout.Report();
+    CHECK(report.size() == sizeof(TailLightReport));
+    if (report.size() < 6)
+        return;
+    CHECK((report[0] == 0x24) && (report[1] == 0xB2) && (report[2] == 0x03));
+    CHECK((report[3] == red) && (report[4] == green) && (report[5] == blue));
+    for (size_t i = 6; i < report.size(); i++)
+        CHECK(report[i] == 0);
+}
+
+static void TestTailLightLayout() {
+    ReportCodec codec;
+    CHECK(codec.Parse(TAILLIGHT_DESC, sizeof(TAILLIGHT_DESC)));
+    CHECK(codec.ReportLength(ReportKind::Feature) == sizeof(TailLightReport));
+    TailLightLayout layout;
+    CHECK(layout.Init(codec));
+    layout.SetColor(0x10, 0x20, 0x30);
+    CheckTailLightReport(layout, 0x10, 0x20, 0x30);
+
+    // fields not described as bytes: fixed layout
+    CHECK(codec.Parse(TAILLIGHT_WORDS_DESC, sizeof(TAILLIGHT_WORDS_DESC)));
+    CHECK(codec.ReportLength(ReportKind::Feature) == sizeof(TailLightReport));
+    TailLightLayout fixed;
+    CHECK(fixed.Init(codec));
+    fixed.SetColor(0xFF, 0x00, 0x80);
+    CheckTailLightReport(fixed, 0xFF, 0x00, 0x80);
+
+    // other devices are rejected
+    CHECK(codec.Parse(MOUSE_DESC, sizeof(MOUSE_DESC)));
+    TailLightLayout mouse;
+    CHECK(!mouse.Init(codec));
+}
+
+static void TestDecodeReadback() {
+    uint8_t report[sizeof(TailLightReport)] = {TailLightLayout::READBACK_REPORT_ID, 0xB2, 0x03, 0x11, 0x22, 0x33};
+    uint8_t red = 0, green = 0, blue = 0;
+    CHECK(TailLightLayout::DecodeReadback(report, sizeof(report), red, green, blue));
+    CHECK((red == 0x11) && (green == 0x22) && (blue == 0x33));
+
+    CHECK(!TailLightLayout::DecodeReadback(report, 5, red, green, blue)); // too short
+    report[1] = 0x00;
+    CHECK(!TailLightLayout::DecodeReadback(report, sizeof(report), red, green, blue)); // control code mismatch
+    report[1] = 0xB2;
+    report[0] = 0x24;
+    CHECK(!TailLightLayout::DecodeReadback(report, sizeof(report), red, green, blue)); // report ID mismatch
+}
+
+
+int main() {
+    TestParseMouse();
+    TestParseItems();
+    TestEncodeUnaligned();
+    TestTailLightLayout();
+    TestDecodeReadback();
+    return CheckResult("ReportCodecTest");
+}
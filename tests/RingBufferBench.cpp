@@ -0,0 +1,72 @@
+/* Benchmark of the HidUtil single-producer single-consumer ring buffer that forwards captured input reports.
+   Measures throughput of an InputReport-sized item between two threads, and checks that no item is lost or reordered. */
+#include "../HidUtil/RingBuffer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+
+/** Same size as InputReport, without the Windows types. */
+struct Report {
+    unsigned long long timestamp = 0;
+    unsigned short     device = 0;
+    unsigned short     length = 0;
+    unsigned char      data[64] = {};
+};
+
+
+/** Push "count" reports from a producer thread while the main thread pops them.
+    Returns ns per item, or a negative value if items were lost or reordered. */
+static double Transfer(size_t capacity, size_t count, size_t& fullRetries) {
+    RingBuffer<Report> ring(capacity);
+    size_t retries = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&ring, &retries, count]() {
+        Report report;
+        report.length = sizeof(report.data);
+        for (size_t i = 0; i < count; i++) {
+            report.timestamp = i;
+            report.data[0] = (unsigned char)i;
+            while (!ring.TryPush(report)) {
+                retries++; // full
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    bool ok = true;
+    Report report;
+    for (size_t i = 0; i < count;) {
+        if (!ring.TryPop(report)) {
+            std::this_thread::yield(); // empty
+            continue;
+        }
+        if ((report.timestamp != i) || (report.data[0] != (unsigned char)i))
+            ok = false;
+        i++;
+    }
+    producer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fullRetries = retries;
+    return ok ? seconds * 1e9 / count : -1;
+}
+
+
+int main() {
+    const size_t COUNT = 5 * 1000 * 1000;
+    const size_t capacities[] = {64, 1024, 16384};
+
+    printf("RingBufferBench: %zu reports of %zu bytes\n", COUNT, sizeof(Report));
+    for (size_t capacity : capacities) {
+        size_t retries = 0;
+        double ns = Transfer(capacity, COUNT, retries);
+        if (ns < 0) {
+            printf("ERROR: Reports lost or reordered (capacity %zu).\n", capacity);
+            return 1;
+        }
+        printf("  capacity %5zu: %6.1f ns/report (%.1f M reports/s, %zu full retries)\n", capacity, ns, 1e3 / ns, retries);
+    }
+    return 0;
+}
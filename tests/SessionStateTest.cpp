@@ -0,0 +1,165 @@
+/* Tests of HidUtil session device tracking with simulated arrival and removal event streams. */
+#include "../HidUtil/SessionState.hpp"
+#include "Check.hpp"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+/** Number of currently open fake devices. */
+static std::atomic<int> s_openDevices{0};
+
+/** Move-only stand-in for an opened HID device. */
+class FakeDevice {
+public:
+    explicit FakeDevice(int id) : m_id(id) {
+        s_openDevices++;
+    }
+    ~FakeDevice() {
+        if (m_id >= 0)
+            s_openDevices--;
+    }
+    FakeDevice(FakeDevice&& obj) noexcept : m_id(obj.m_id) {
+        obj.m_id = -1;
+    }
+    FakeDevice& operator=(FakeDevice&&) = delete;
+
+    int Id() const {
+        return m_id;
+    }
+
+private:
+    int m_id = -1;
+};
+
+
+/** Simulated system: paths starting with "mouse" match, and paths in "gone" fail to open. */
+struct FakeSystem {
+    std::optional<FakeDevice> Open(const std::wstring& path) {
+        opens++;
+        if (path.compare(0, 5, L"mouse") != 0)
+            return std::nullopt; // other HID device
+        if (gone.count(path))
+            return std::nullopt; // removed while being opened
+        return FakeDevice(nextId++);
+    }
+
+    std::atomic<int>       opens{0};
+    std::set<std::wstring> gone;
+    int                    nextId = 0;
+};
+
+
+static void TestEventStream() {
+    FakeSystem sys;
+    {
+        SessionState<FakeDevice> state([&sys](const std::wstring& path) { return sys.Open(path); });
+
+        // initial enumeration
+        state.Add(L"mouse#1", FakeDevice(100));
+        CHECK(state.Count() == 1);
+        unsigned int gen = state.Generation();
+
+        // arrival of a matching device, then a duplicate notification
+        CHECK(state.OnArrival(L"mouse#2"));
+        CHECK(!state.OnArrival(L"mouse#2"));
+        CHECK(sys.opens == 1);
+        CHECK(state.Count() == 2);
+        CHECK(state.Generation() == gen + 1);
+
+        // arrival of a non-matching device is only checked once
+        CHECK(!state.OnArrival(L"keyboard#1"));
+        CHECK(!state.OnArrival(L"keyboard#1"));
+        CHECK(sys.opens == 2);
+        CHECK(state.Count() == 2);
+        CHECK(state.Generation() == gen + 1);
+
+        // device removed during arrival
+        sys.gone.insert(L"mouse#3");
+        CHECK(!state.OnArrival(L"mouse#3"));
+        CHECK(state.Count() == 2);
+
+        // removal closes the device. Unknown and repeated removals are ignored.
+        CHECK(state.OnRemoval(L"mouse#1"));
+        CHECK(!state.OnRemoval(L"mouse#1"));
+        CHECK(!state.OnRemoval(L"mouse#9"));
+        CHECK(state.Count() == 1);
+        CHECK(s_openDevices == 1);
+        CHECK(state.Generation() == gen + 2);
+
+        // replug of the same device reopens it
+        CHECK(state.OnArrival(L"mouse#1"));
+        CHECK(state.Count() == 2);
+
+        // removal forgets rejected paths, so that a reused path is checked again
+        sys.gone.erase(L"mouse#3");
+        CHECK(!state.OnRemoval(L"mouse#3"));
+        CHECK(state.OnArrival(L"mouse#3"));
+        CHECK(state.Count() == 3);
+
+        int visited = 0;
+        state.ForEach([&visited](const std::wstring& path, FakeDevice& dev) {
+            CHECK(path.compare(0, 5, L"mouse") == 0);
+            CHECK(dev.Id() >= 0);
+            visited++;
+        });
+        CHECK(visited == 3);
+        CHECK(s_openDevices == 3);
+    }
+    CHECK(s_openDevices == 0); // all devices closed with the session
+}
+
+
+/** Random arrival/removal streams from a notification thread while clients iterate the devices. */
+static void TestConcurrentStream() {
+    const int PATHS = 16;
+    const int EVENTS = 200000;
+
+    FakeSystem sys;
+    std::vector<bool> present(PATHS, false); // expected state after the last event per path
+    {
+        SessionState<FakeDevice> state([&sys](const std::wstring& path) { return sys.Open(path); });
+
+        std::atomic<bool> done{false};
+        std::thread client([&]() {
+            while (!done) {
+                size_t count = 0;
+                state.ForEach([&count](const std::wstring&, FakeDevice& dev) {
+                    CHECK(dev.Id() >= 0);
+                    count++;
+                });
+                CHECK(count <= PATHS);
+            }
+        });
+
+        std::mt19937 rng(42);
+        for (int i = 0; i < EVENTS; i++) {
+            int idx = rng() % PATHS;
+            std::wstring path = ((idx % 4) ? L"mouse#" : L"keyboard#") + std::to_wstring(idx);
+            if (rng() % 2) {
+                state.OnArrival(path);
+                present[idx] = (idx % 4) != 0;
+            } else {
+                state.OnRemoval(path);
+                present[idx] = false;
+            }
+        }
+        done = true;
+        client.join();
+
+        size_t expected = 0;
+        for (bool p : present)
+            expected += p;
+        CHECK(state.Count() == expected);
+        CHECK((size_t)s_openDevices == expected);
+    }
+    CHECK(s_openDevices == 0);
+}
+
+
+int main() {
+    TestEventStream();
+    TestConcurrentStream();
+    return CheckResult("SessionStateTest");
+}